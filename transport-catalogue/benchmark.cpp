@@ -0,0 +1,224 @@
+#include "benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "counting_resource.h"
+
+using namespace std::literals;
+
+namespace benchmark {
+
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        double MillisecondsSince(Clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+
+        std::string StopName(size_t index) {
+            return "Stop "s + std::to_string(index) + " Synthetic Avenue"s;
+        }
+
+        std::string_view EngineName(transport_router::RouterEngine engine) {
+            switch (engine) {
+                case transport_router::RouterEngine::FLOYD_WARSHALL: return "floyd_warshall"sv;
+                case transport_router::RouterEngine::DIJKSTRA: return "dijkstra"sv;
+                case transport_router::RouterEngine::CONTRACTION_HIERARCHIES: return "contraction_hierarchies"sv;
+                case transport_router::RouterEngine::A_STAR: return "a_star"sv;
+                case transport_router::RouterEngine::BIDIRECTIONAL_DIJKSTRA: return "bidirectional_dijkstra"sv;
+                case transport_router::RouterEngine::RAPTOR: return "raptor"sv;
+            }
+            return "unknown"sv;
+        }
+
+        double TotalTime(const transport_router::EdgeDescriptions& route) {
+            double total = 0.0;
+            for (const auto& description : route) {
+                total += description.time_;
+            }
+            return total;
+        }
+    }
+
+    void FillSyntheticNetwork(transport_catalogue::TransportCatalogue& catalogue, const NetworkShape& shape) {
+        const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(shape.stop_count))));
+        std::vector<std::string> names;
+        names.reserve(shape.stop_count);
+        for (size_t i = 0; i < shape.stop_count; ++i) {
+            names.push_back(StopName(i));
+            // Сетка с шагом около 300 метров
+            catalogue.AddStop({names.back(), {55.5 + 0.0027 * static_cast<double>(i / side),
+                                              37.3 + 0.0047 * static_cast<double>(i % side)}});
+        }
+
+        std::mt19937 generator(shape.seed);
+        for (size_t bus = 0; bus < shape.bus_count; ++bus) {
+            // Маршрут — случайное блуждание по соседним узлам сетки
+            size_t current = generator() % shape.stop_count;
+            std::vector<std::string_view> route{names[current]};
+            for (size_t k = 1; k < shape.stops_per_bus; ++k) {
+                const size_t row = current / side;
+                const size_t col = current % side;
+                size_t next = current;
+                switch (generator() % 4) {
+                    case 0: next = row > 0 ? current - side : current + side; break;
+                    case 1: next = current + side; break;
+                    case 2: next = col > 0 ? current - 1 : current + 1; break;
+                    default: next = col + 1 < side ? current + 1 : current - 1; break;
+                }
+                if (next >= shape.stop_count) {
+                    next = current >= side ? current - side : current;
+                }
+                if (next == current) {
+                    continue;
+                }
+                const domain::Stop* from = catalogue.FindStop(names[current]);
+                catalogue.SetDistanceBetweenStop(names[next], from, 250 + generator() % 200);
+                route.push_back(names[next]);
+                current = next;
+            }
+            catalogue.AddBus("Bus "s + std::to_string(bus), route, bus % 3 == 0);
+        }
+        catalogue.Freeze();
+    }
+
+    void BenchmarkCatalogueAllocation(std::ostream& out, const NetworkShape& shape) {
+        out << "Catalogue allocation: "s << shape.stop_count << " stops, "s << shape.bus_count << " buses x "s
+            << shape.stops_per_bus << " stops"s << std::endl;
+
+        // make_resource строит ресурс поверх считающего; nullptr — контейнеры обращаются к куче напрямую
+        const auto run = [&out, &shape](std::string_view title, auto make_resource) {
+            counting_resource::CountingResource counting(std::pmr::new_delete_resource());
+            std::unique_ptr<std::pmr::memory_resource> resource = make_resource(&counting);
+            auto catalogue = std::make_unique<transport_catalogue::TransportCatalogue>(
+                    resource ? resource.get() : &counting);
+
+            const auto ingest_start = Clock::now();
+            FillSyntheticNetwork(*catalogue, shape);
+            const double ingest_ms = MillisecondsSince(ingest_start);
+
+            const auto teardown_start = Clock::now();
+            catalogue.reset();
+            resource.reset();
+            const double teardown_ms = MillisecondsSince(teardown_start);
+
+            out << "  "s << title << ": ingest "s << ingest_ms << " ms, "s
+                << counting.GetAllocationCount() << " allocations, "s
+                << counting.GetBytesAllocated() / 1024 << " KiB, teardown "s << teardown_ms << " ms"s << std::endl;
+        };
+
+        run("new_delete"sv, [](std::pmr::memory_resource*) {
+            return std::unique_ptr<std::pmr::memory_resource>{};
+        });
+        // Арена по умолчанию: крупные блоки, освобождаются разом
+        run("monotonic"sv, [](std::pmr::memory_resource* upstream) {
+            return std::unique_ptr<std::pmr::memory_resource>(std::make_unique<std::pmr::monotonic_buffer_resource>(upstream));
+        });
+        run("unsynchronized_pool"sv, [](std::pmr::memory_resource* upstream) {
+            return std::unique_ptr<std::pmr::memory_resource>(std::make_unique<std::pmr::unsynchronized_pool_resource>(upstream));
+        });
+    }
+
+    void BenchmarkRouterEngines(std::ostream& out, const NetworkShape& shape,
+                                const std::vector<transport_router::RouterEngine>& engines, size_t query_count,
+                                transport_router::GraphModel graph_model) {
+        transport_catalogue::TransportCatalogue catalogue;
+        FillSyntheticNetwork(catalogue, shape);
+        const std::vector<std::string_view> stops = catalogue.GetUsedStopNames();
+        out << "Router engines: "s << stops.size() << " stops with buses, "s << query_count << " queries, "s
+            << (graph_model == transport_router::GraphModel::ROUTE_LINES ? "route_lines"s : "stop_pairs"s) << " graph"s << std::endl;
+
+        std::mt19937 generator(shape.seed);
+        std::vector<transport_router::RouteQuery> queries;
+        for (size_t i = 0; i < query_count && !stops.empty(); ++i) {
+            queries.emplace_back(stops[generator() % stops.size()], stops[generator() % stops.size()]);
+        }
+
+        std::vector<std::optional<double>> reference;
+        for (const transport_router::RouterEngine engine : engines) {
+            transport_router::RoutingSettings settings{6.0, 40.0};
+            settings.router_engine_ = engine;
+            settings.graph_model_ = graph_model;
+
+            const auto build_start = Clock::now();
+            const transport_router::TransportRouter router(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+            const double build_ms = MillisecondsSince(build_start);
+
+            std::vector<std::optional<double>> times;
+            times.reserve(queries.size());
+            const auto query_start = Clock::now();
+            for (const auto& [from, to] : queries) {
+                const auto route = router.BuildRoute(from, to);
+                times.push_back(route ? std::optional(TotalTime(*route)) : std::nullopt);
+            }
+            const double query_us = MillisecondsSince(query_start) * 1000.0 / static_cast<double>(std::max<size_t>(queries.size(), 1));
+
+            size_t mismatches = 0;
+            if (reference.empty()) {
+                reference = times;
+            } else {
+                for (size_t i = 0; i < times.size(); ++i) {
+                    const bool same = times[i].has_value() == reference[i].has_value()
+                            && (!times[i] || std::abs(*times[i] - *reference[i]) < 1e-6);
+                    mismatches += same ? 0 : 1;
+                }
+            }
+
+            out << "  "s << EngineName(engine) << ": build "s << build_ms << " ms, graph "s
+                << router.GetGraphMemoryUsage() / 1024 << " KiB, memory "s
+                << router.GetRouterMemoryUsage() / 1024 << " KiB, query "s << query_us << " us, settled "s
+                << router.GetSettledVertexCount() / std::max<size_t>(queries.size(), 1) << " vertices per query, mismatches "s
+                << mismatches << std::endl;
+        }
+    }
+
+    void BenchmarkFloydWarshallThreads(std::ostream& out, const NetworkShape& shape, const std::vector<size_t>& thread_counts) {
+        transport_catalogue::TransportCatalogue catalogue;
+        FillSyntheticNetwork(catalogue, shape);
+        // Граф берётся у дешёвого в построении маршрутизатора, чтобы замерять только сам Флойд–Уоршелл
+        transport_router::RoutingSettings settings{6.0, 40.0};
+        settings.router_engine_ = transport_router::RouterEngine::DIJKSTRA;
+        const transport_router::RouterState state = transport_router::TransportRouter(
+                settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue)).GetState();
+        transport_router::GraphBuilder builder(state.vertex_count);
+        for (const auto& edge : state.edges) {
+            builder.AddEdge(edge);
+        }
+        const transport_router::Graph graph = builder.Build();
+        out << "Floyd-Warshall threads: "s << graph.GetVertexCount() << " vertices, "s << graph.GetEdgeCount() << " edges, "s
+            << std::thread::hardware_concurrency() << " hardware threads"s << std::endl;
+
+        double first_ms = 0.0;
+        for (const size_t thread_count : thread_counts) {
+            const auto build_start = Clock::now();
+            const transport_router::Router router(graph, thread_count);
+            const double build_ms = MillisecondsSince(build_start);
+            if (first_ms == 0.0) {
+                first_ms = build_ms;
+            }
+            out << "  "s << thread_count << " threads: build "s << build_ms << " ms, speedup "s << first_ms / build_ms << std::endl;
+        }
+    }
+
+    void RunBenchmarks(std::ostream& out) {
+        using transport_router::RouterEngine;
+        BenchmarkCatalogueAllocation(out);
+        BenchmarkRouterEngines(out, SMALL_NETWORK,
+                               {RouterEngine::FLOYD_WARSHALL, RouterEngine::DIJKSTRA, RouterEngine::BIDIRECTIONAL_DIJKSTRA,
+                                RouterEngine::A_STAR, RouterEngine::CONTRACTION_HIERARCHIES, RouterEngine::RAPTOR});
+        // На полной сети Флойд–Уоршелл не помещается в память
+        BenchmarkRouterEngines(out, NetworkShape{}, {RouterEngine::DIJKSTRA, RouterEngine::BIDIRECTIONAL_DIJKSTRA, RouterEngine::A_STAR,
+                                                     RouterEngine::CONTRACTION_HIERARCHIES, RouterEngine::RAPTOR}, 200);
+        BenchmarkRouterEngines(out, NetworkShape{}, {RouterEngine::DIJKSTRA, RouterEngine::BIDIRECTIONAL_DIJKSTRA}, 200,
+                               transport_router::GraphModel::ROUTE_LINES);
+        BenchmarkFloydWarshallThreads(out, SMALL_NETWORK, {1, 2, 4, 8});
+    }
+
+}
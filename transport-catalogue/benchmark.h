@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+/*
+ * Замеры производительности справочника. Как и юнит-тесты, в main не подключены
+ * и запускаются вручную вызовом RunBenchmarks() из отдельной сборки.
+ */
+namespace benchmark {
+
+    // Параметры синтетической сети: остановки на сетке, маршруты из случайных соседних остановок
+    struct NetworkShape {
+        size_t stop_count = 20000;
+        size_t bus_count = 2000;
+        size_t stops_per_bus = 40;
+        unsigned seed = 42;
+    };
+
+    void FillSyntheticNetwork(transport_catalogue::TransportCatalogue& catalogue, const NetworkShape& shape);
+
+    // Загрузка сети в справочник с разными ресурсами памяти: время загрузки, число выделений, время разрушения
+    void BenchmarkCatalogueAllocation(std::ostream& out, const NetworkShape& shape = {});
+
+    // Сеть, на которой Флойд–Уоршелл ещё укладывается в секунды: V = 2 x число остановок
+    constexpr NetworkShape SMALL_NETWORK{600, 80, 15, 42};
+
+    /**
+     * Алгоритмы маршрутизации на одной сети: время построения, память графа и алгоритма,
+     * средняя задержка запроса, число извлечённых из кучи вершин на запрос и число расхождений
+     * во времени маршрута с первым алгоритмом.
+     */
+    void BenchmarkRouterEngines(std::ostream& out, const NetworkShape& shape,
+                                const std::vector<transport_router::RouterEngine>& engines, size_t query_count = 2000,
+                                transport_router::GraphModel graph_model = transport_router::GraphModel::STOP_PAIRS);
+
+    /**
+     * Построение Флойда–Уоршелла по графу сети с разным числом потоков: время построения и ускорение
+     * относительно первого значения thread_counts. Ускорение ограничено числом ядер машины, оно выводится тоже.
+     */
+    void BenchmarkFloydWarshallThreads(std::ostream& out, const NetworkShape& shape, const std::vector<size_t>& thread_counts);
+
+    void RunBenchmarks(std::ostream& out = std::cerr);
+
+}
@@ -0,0 +1,527 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    /**
+     * Иерархия сжатий (Contraction Hierarchies).
+     *
+     * Предобработка удаляет («сжимает») вершины по одной в порядке важности. При сжатии v для каждой пары рёбер
+     * u -> v -> w добавляется ребро-сокращение u -> w с весом пути через v, если ограниченный поиск из u
+     * в обход v не нашёл пути до w не длиннее (свидетеля). Важность вершины — число нужных сокращений минус
+     * число удаляемых рёбер плюс число уже сжатых соседей; она пересчитывается лениво, когда вершина
+     * оказывается наверху очереди. Номер вершины в порядке сжатия — её ранг.
+     *
+     * Запрос — двунаправленная Дейкстра только вверх по рангу: прямой поиск из from по рёбрам к вершинам
+     * большего ранга, обратный из to по входящим рёбрам от вершин большего ранга. Сокращение помнит два ребра,
+     * из которых составлено, поэтому найденный путь раскрывается в рёбра исходного графа. Вершину, до которой
+     * короче дойти через уже достигнутую вершину большего ранга, поиск не продолжает (stall-on-demand).
+     * Рабочие массивы запроса, как у DijkstraRouter, берутся из рабочего пространства потока.
+     */
+    template <typename Weight>
+    class ContractionHierarchyRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using typename RouterBase<Weight>::RouteInfo;
+
+        explicit ContractionHierarchyRouter(const Graph& graph);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+        size_t GetMemoryUsage() const override;
+        uint64_t GetSettledVertexCount() const override;
+        size_t GetShortcutCount() const;
+
+    private:
+        static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+        static constexpr Weight ZERO_WEIGHT{};
+        // Сколько вершин может извлечь поиск свидетеля, прежде чем сдаться и согласиться на сокращение
+        static constexpr size_t WITNESS_SETTLE_LIMIT = 100;
+
+        struct HierarchyEdge {
+            VertexId from;
+            VertexId to;
+            Weight weight;
+            EdgeId original; // Ребро исходного графа или NO_EDGE у сокращения
+            EdgeId first;    // У сокращения — рёбра иерархии from -> v и v -> to
+            EdgeId second;
+            bool active;     // false, если позже появилось более короткое параллельное сокращение
+        };
+
+        struct HeapEntry {
+            Weight weight;
+            VertexId vertex;
+
+            bool operator>(const HeapEntry& other) const {
+                return weight > other.weight;
+            }
+        };
+
+        // Рёбра поиска вверх: рёбра вершины v — edges[offsets[v]..offsets[v + 1])
+        struct UpwardGraph {
+            std::vector<size_t> offsets;
+            std::vector<EdgeId> edges;
+        };
+
+        // Списки рёбер между ещё не сжатыми вершинами и поиск свидетелей, нужны только в конструкторе
+        struct ContractionState {
+            std::vector<std::vector<EdgeId>> out;
+            std::vector<std::vector<EdgeId>> in;
+            std::vector<size_t> contracted_neighbors;
+            std::vector<bool> dirty; // Окрестность изменилась после последнего расчёта важности
+            std::vector<Weight> weights;
+            std::vector<uint32_t> marks;
+            std::vector<HeapEntry> heap;
+            uint32_t search = 0;
+            // Цели поиска свидетеля: для соседа w — вес пути через сжимаемую вершину
+            std::vector<Weight> target_weights;
+            std::vector<uint32_t> target_marks;
+            std::vector<uint32_t> witnessed; // Найден путь не длиннее, чем через сжимаемую вершину
+        };
+
+        struct SearchSpace {
+            std::vector<Weight> weights;
+            std::vector<EdgeId> prev_edges;
+            std::vector<uint32_t> marks;
+            std::vector<HeapEntry> heap;
+        };
+
+        struct Workspace {
+            SearchSpace forward;
+            SearchSpace backward;
+            uint32_t query = 0;
+
+            void Prepare(size_t vertex_count) {
+                for (SearchSpace* space : {&forward, &backward}) {
+                    if (space->marks.size() < vertex_count) {
+                        space->weights.resize(vertex_count);
+                        space->prev_edges.resize(vertex_count);
+                        space->marks.resize(vertex_count, 0);
+                    }
+                    space->heap.clear();
+                }
+                if (++query == 0) {
+                    std::fill(forward.marks.begin(), forward.marks.end(), 0);
+                    std::fill(backward.marks.begin(), backward.marks.end(), 0);
+                    query = 1;
+                }
+            }
+        };
+
+        static Workspace& GetWorkspace() {
+            thread_local Workspace workspace;
+            return workspace;
+        }
+
+        void AddEdge(ContractionState& state, HierarchyEdge edge);
+        // Ищет свидетелей для target_count целей, отмеченных в state номером текущего поиска
+        void FindWitnesses(ContractionState& state, VertexId source, VertexId skip, Weight max_weight, size_t target_count) const;
+        // Число сокращений, нужных при сжатии vertex; при add == true они добавляются
+        size_t ProcessVertex(ContractionState& state, VertexId vertex, bool add);
+        std::ptrdiff_t GetPriority(ContractionState& state, VertexId vertex);
+        void ContractVertex(ContractionState& state, VertexId vertex);
+        void BuildUpwardGraphs();
+        void Unpack(EdgeId edge_id, std::vector<EdgeId>& result) const;
+
+        size_t vertex_count_;
+        std::vector<HierarchyEdge> edges_;
+        std::vector<size_t> rank_;
+        UpwardGraph forward_;  // Исходящие рёбра к вершинам большего ранга
+        UpwardGraph backward_; // Входящие рёбра от вершин большего ранга
+        size_t shortcut_count_ = 0;
+        mutable std::atomic<uint64_t> settled_count_ = 0;
+    };
+
+    template <typename Weight>
+    ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph)
+            : vertex_count_(graph.GetVertexCount()),
+              rank_(graph.GetVertexCount(), 0) {
+        ContractionState state;
+        state.out.resize(vertex_count_);
+        state.in.resize(vertex_count_);
+        state.contracted_neighbors.assign(vertex_count_, 0);
+        state.dirty.assign(vertex_count_, false);
+        state.weights.resize(vertex_count_);
+        state.marks.assign(vertex_count_, 0);
+        state.target_weights.resize(vertex_count_);
+        state.target_marks.assign(vertex_count_, 0);
+        state.witnessed.assign(vertex_count_, 0);
+
+        // Из параллельных рёбер остаётся самое лёгкое, при равенстве — с меньшим номером
+        std::vector<EdgeId> order(graph.GetEdgeCount());
+        for (EdgeId edge_id = 0; edge_id < order.size(); ++edge_id) {
+            if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            order[edge_id] = edge_id;
+        }
+        std::sort(order.begin(), order.end(), [&graph](EdgeId lhs, EdgeId rhs) {
+            const auto& left = graph.GetEdge(lhs);
+            const auto& right = graph.GetEdge(rhs);
+            return std::tie(left.from, left.to, left.weight, lhs) < std::tie(right.from, right.to, right.weight, rhs);
+        });
+        for (size_t i = 0; i < order.size(); ++i) {
+            const auto& edge = graph.GetEdge(order[i]);
+            const bool duplicate = i > 0 && graph.GetEdge(order[i - 1]).from == edge.from && graph.GetEdge(order[i - 1]).to == edge.to;
+            if (!duplicate && edge.from != edge.to) {
+                AddEdge(state, {edge.from, edge.to, edge.weight, order[i], NO_EDGE, NO_EDGE, true});
+            }
+        }
+
+        using QueueEntry = std::pair<std::ptrdiff_t, VertexId>;
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<>> queue;
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            queue.push({GetPriority(state, vertex), vertex});
+        }
+        size_t rank = 0;
+        while (!queue.empty()) {
+            const VertexId vertex = queue.top().second;
+            queue.pop();
+            // Важность пересчитывается, только если после прошлого расчёта сжали кого-то из соседей
+            if (state.dirty[vertex]) {
+                state.dirty[vertex] = false;
+                const std::ptrdiff_t priority = GetPriority(state, vertex);
+                if (!queue.empty() && priority > queue.top().first) {
+                    queue.push({priority, vertex});
+                    continue;
+                }
+            }
+            ContractVertex(state, vertex);
+            rank_[vertex] = rank++;
+        }
+        BuildUpwardGraphs();
+    }
+
+    template <typename Weight>
+    void ContractionHierarchyRouter<Weight>::AddEdge(ContractionState& state, HierarchyEdge edge) {
+        const EdgeId id = edges_.size();
+        if (edge.original == NO_EDGE) {
+            ++shortcut_count_;
+            // Более длинные параллельные рёбра больше не нужны ни при сжатии, ни в запросах
+            std::erase_if(state.out[edge.from], [this, &state, &edge](EdgeId other) {
+                HierarchyEdge& existing = edges_[other];
+                if (existing.to != edge.to || existing.weight <= edge.weight) {
+                    return false;
+                }
+                existing.active = false;
+                std::erase(state.in[edge.to], other);
+                return true;
+            });
+        }
+        edges_.push_back(edge);
+        state.out[edge.from].push_back(id);
+        state.in[edge.to].push_back(id);
+    }
+
+    template <typename Weight>
+    void ContractionHierarchyRouter<Weight>::FindWitnesses(ContractionState& state, VertexId source, VertexId skip,
+                                                           Weight max_weight, size_t target_count) const {
+        auto& heap = state.heap;
+        heap.clear();
+        state.marks[source] = state.search;
+        state.weights[source] = ZERO_WEIGHT;
+        heap.push_back({ZERO_WEIGHT, source});
+        size_t settled = 0;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+            const HeapEntry entry = heap.back();
+            heap.pop_back();
+            if (state.weights[entry.vertex] < entry.weight) {
+                continue;
+            }
+            if (max_weight < entry.weight || ++settled > WITNESS_SETTLE_LIMIT) {
+                break;
+            }
+            for (const EdgeId edge_id : state.out[entry.vertex]) {
+                const HierarchyEdge& edge = edges_[edge_id];
+                if (edge.to == skip) {
+                    continue;
+                }
+                const Weight candidate = entry.weight + edge.weight;
+                if (state.marks[edge.to] != state.search || candidate < state.weights[edge.to]) {
+                    state.marks[edge.to] = state.search;
+                    state.weights[edge.to] = candidate;
+                    heap.push_back({candidate, edge.to});
+                    std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+                    // Обычно свидетель — прямое ребро маршрута, и поиск заканчивается на первой вершине
+                    if (state.target_marks[edge.to] == state.search && state.witnessed[edge.to] != state.search
+                            && !(state.target_weights[edge.to] < candidate)) {
+                        state.witnessed[edge.to] = state.search;
+                        if (--target_count == 0) {
+                            return;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Weight>
+    size_t ContractionHierarchyRouter<Weight>::ProcessVertex(ContractionState& state, VertexId vertex, bool add) {
+        size_t shortcuts = 0;
+        // Сокращения меняют списки соседей, но не списки самой vertex
+        const std::vector<EdgeId> incoming = state.in[vertex];
+        const std::vector<EdgeId> outgoing = state.out[vertex];
+        // В соседа, куда ведут только рёбра из vertex, обойти её нельзя: свидетеля для него не ищем
+        std::vector<bool> bypassable(outgoing.size());
+        for (size_t i = 0; i < outgoing.size(); ++i) {
+            const auto& target_in = state.in[edges_[outgoing[i]].to];
+            bypassable[i] = std::any_of(target_in.begin(), target_in.end(), [this, vertex](EdgeId id) {
+                return edges_[id].from != vertex;
+            });
+        }
+        for (const EdgeId in_id : incoming) {
+            const HierarchyEdge in_edge = edges_[in_id];
+            if (++state.search == 0) {
+                std::fill(state.marks.begin(), state.marks.end(), 0);
+                std::fill(state.target_marks.begin(), state.target_marks.end(), 0);
+                std::fill(state.witnessed.begin(), state.witnessed.end(), 0);
+                state.search = 1;
+            }
+            std::optional<Weight> max_weight;
+            size_t target_count = 0;
+            for (size_t i = 0; i < outgoing.size(); ++i) {
+                const HierarchyEdge& out_edge = edges_[outgoing[i]];
+                if (out_edge.to == in_edge.from || !bypassable[i]) {
+                    continue;
+                }
+                const Weight candidate = in_edge.weight + out_edge.weight;
+                max_weight = max_weight ? std::max(*max_weight, candidate) : candidate;
+                if (state.target_marks[out_edge.to] != state.search) {
+                    state.target_marks[out_edge.to] = state.search;
+                    state.target_weights[out_edge.to] = candidate;
+                    ++target_count;
+                } else {
+                    state.target_weights[out_edge.to] = std::min(state.target_weights[out_edge.to], candidate);
+                }
+            }
+            if (max_weight) {
+                FindWitnesses(state, in_edge.from, vertex, *max_weight, target_count);
+            }
+            for (const EdgeId out_id : outgoing) {
+                const HierarchyEdge out_edge = edges_[out_id];
+                if (out_edge.to == in_edge.from) {
+                    continue;
+                }
+                const Weight candidate = in_edge.weight + out_edge.weight;
+                // Свидетель найден, или это не самое лёгкое из параллельных рёбер к той же вершине
+                const bool target = state.target_marks[out_edge.to] == state.search;
+                if (target && (state.witnessed[out_edge.to] == state.search || state.target_weights[out_edge.to] < candidate)) {
+                    continue;
+                }
+                ++shortcuts;
+                if (add) {
+                    AddEdge(state, {in_edge.from, out_edge.to, candidate, NO_EDGE, in_id, out_id, true});
+                }
+            }
+        }
+        return shortcuts;
+    }
+
+    template <typename Weight>
+    std::ptrdiff_t ContractionHierarchyRouter<Weight>::GetPriority(ContractionState& state, VertexId vertex) {
+        const auto shortcuts = static_cast<std::ptrdiff_t>(ProcessVertex(state, vertex, false));
+        const auto removed = static_cast<std::ptrdiff_t>(state.in[vertex].size() + state.out[vertex].size());
+        return shortcuts - removed + static_cast<std::ptrdiff_t>(state.contracted_neighbors[vertex]);
+    }
+
+    template <typename Weight>
+    void ContractionHierarchyRouter<Weight>::ContractVertex(ContractionState& state, VertexId vertex) {
+        ProcessVertex(state, vertex, true);
+        // Рёбра сжатой вершины остаются в иерархии, но из списков соседей убираются
+        for (const EdgeId edge_id : state.out[vertex]) {
+            const VertexId neighbor = edges_[edge_id].to;
+            ++state.contracted_neighbors[neighbor];
+            state.dirty[neighbor] = true;
+            std::erase_if(state.in[neighbor], [this, vertex](EdgeId other) {
+                return edges_[other].from == vertex;
+            });
+        }
+        for (const EdgeId edge_id : state.in[vertex]) {
+            const VertexId neighbor = edges_[edge_id].from;
+            ++state.contracted_neighbors[neighbor];
+            state.dirty[neighbor] = true;
+            std::erase_if(state.out[neighbor], [this, vertex](EdgeId other) {
+                return edges_[other].to == vertex;
+            });
+        }
+        state.out[vertex] = {};
+        state.in[vertex] = {};
+    }
+
+    template <typename Weight>
+    void ContractionHierarchyRouter<Weight>::BuildUpwardGraphs() {
+        forward_.offsets.assign(vertex_count_ + 1, 0);
+        backward_.offsets.assign(vertex_count_ + 1, 0);
+        for (const HierarchyEdge& edge : edges_) {
+            if (edge.active) {
+                ++(rank_[edge.from] < rank_[edge.to] ? forward_.offsets[edge.from + 1] : backward_.offsets[edge.to + 1]);
+            }
+        }
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            forward_.offsets[vertex + 1] += forward_.offsets[vertex];
+            backward_.offsets[vertex + 1] += backward_.offsets[vertex];
+        }
+        forward_.edges.resize(forward_.offsets.back());
+        backward_.edges.resize(backward_.offsets.back());
+        std::vector<size_t> forward_fill(forward_.offsets.begin(), forward_.offsets.end() - 1);
+        std::vector<size_t> backward_fill(backward_.offsets.begin(), backward_.offsets.end() - 1);
+        for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+            const HierarchyEdge& edge = edges_[edge_id];
+            if (!edge.active) {
+                continue;
+            }
+            if (rank_[edge.from] < rank_[edge.to]) {
+                forward_.edges[forward_fill[edge.from]++] = edge_id;
+            } else {
+                backward_.edges[backward_fill[edge.to]++] = edge_id;
+            }
+        }
+    }
+
+    template <typename Weight>
+    void ContractionHierarchyRouter<Weight>::Unpack(EdgeId edge_id, std::vector<EdgeId>& result) const {
+        std::vector<EdgeId> stack{edge_id};
+        while (!stack.empty()) {
+            const HierarchyEdge& edge = edges_[stack.back()];
+            stack.pop_back();
+            if (edge.original != NO_EDGE) {
+                result.push_back(edge.original);
+            } else {
+                stack.push_back(edge.second);
+                stack.push_back(edge.first);
+            }
+        }
+    }
+
+    template <typename Weight>
+    std::optional<typename ContractionHierarchyRouter<Weight>::RouteInfo> ContractionHierarchyRouter<Weight>::BuildRoute(
+            VertexId from, VertexId to) const {
+        if (from >= vertex_count_ || to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (from == to) {
+            return RouteInfo{ZERO_WEIGHT, {}};
+        }
+
+        Workspace& workspace = GetWorkspace();
+        workspace.Prepare(vertex_count_);
+        const uint32_t query = workspace.query;
+        SearchSpace& forward = workspace.forward;
+        SearchSpace& backward = workspace.backward;
+        for (auto [space, root] : {std::pair{&forward, from}, std::pair{&backward, to}}) {
+            space->weights[root] = ZERO_WEIGHT;
+            space->prev_edges[root] = NO_EDGE;
+            space->marks[root] = query;
+            space->heap.push_back({ZERO_WEIGHT, root});
+        }
+
+        std::optional<Weight> best;
+        VertexId meeting = from;
+        uint64_t settled_count = 0;
+        while (!forward.heap.empty() || !backward.heap.empty()) {
+            // Продвигается направление с меньшим минимумом в куче
+            const bool is_forward = backward.heap.empty()
+                    || (!forward.heap.empty() && !(backward.heap.front().weight < forward.heap.front().weight));
+            SearchSpace& space = is_forward ? forward : backward;
+            const SearchSpace& other = is_forward ? backward : forward;
+
+            std::pop_heap(space.heap.begin(), space.heap.end(), std::greater<>{});
+            const HeapEntry entry = space.heap.back();
+            space.heap.pop_back();
+            if (space.weights[entry.vertex] < entry.weight) {
+                continue;
+            }
+            ++settled_count;
+            if (best && !(entry.weight < *best)) {
+                // Дальше в этом направлении пути только длиннее найденного
+                space.heap.clear();
+                continue;
+            }
+            if (other.marks[entry.vertex] == query) {
+                const Weight total = entry.weight + other.weights[entry.vertex];
+                if (!best || total < *best) {
+                    best = total;
+                    meeting = entry.vertex;
+                }
+            }
+
+            // Остановка по требованию: если в вершину короче прийти сверху, её рёбра не дадут кратчайшего пути
+            const UpwardGraph& downward = is_forward ? backward_ : forward_;
+            bool stalled = false;
+            for (size_t i = downward.offsets[entry.vertex]; i < downward.offsets[entry.vertex + 1] && !stalled; ++i) {
+                const HierarchyEdge& edge = edges_[downward.edges[i]];
+                const VertexId higher = is_forward ? edge.from : edge.to;
+                stalled = space.marks[higher] == query && space.weights[higher] + edge.weight < entry.weight;
+            }
+            if (stalled) {
+                continue;
+            }
+
+            const UpwardGraph& upward = is_forward ? forward_ : backward_;
+            for (size_t i = upward.offsets[entry.vertex]; i < upward.offsets[entry.vertex + 1]; ++i) {
+                const HierarchyEdge& edge = edges_[upward.edges[i]];
+                const VertexId next = is_forward ? edge.to : edge.from;
+                const Weight candidate = entry.weight + edge.weight;
+                if (space.marks[next] != query || candidate < space.weights[next]) {
+                    space.marks[next] = query;
+                    space.weights[next] = candidate;
+                    space.prev_edges[next] = upward.edges[i];
+                    space.heap.push_back({candidate, next});
+                    std::push_heap(space.heap.begin(), space.heap.end(), std::greater<>{});
+                }
+            }
+        }
+        settled_count_.fetch_add(settled_count, std::memory_order_relaxed);
+        if (!best) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> hierarchy_edges;
+        for (VertexId vertex = meeting; forward.prev_edges[vertex] != NO_EDGE; vertex = edges_[forward.prev_edges[vertex]].from) {
+            hierarchy_edges.push_back(forward.prev_edges[vertex]);
+        }
+        std::reverse(hierarchy_edges.begin(), hierarchy_edges.end());
+        for (VertexId vertex = meeting; backward.prev_edges[vertex] != NO_EDGE; vertex = edges_[backward.prev_edges[vertex]].to) {
+            hierarchy_edges.push_back(backward.prev_edges[vertex]);
+        }
+        std::vector<EdgeId> edges;
+        for (const EdgeId edge_id : hierarchy_edges) {
+            Unpack(edge_id, edges);
+        }
+        return RouteInfo{*best, std::move(edges)};
+    }
+
+    template <typename Weight>
+    size_t ContractionHierarchyRouter<Weight>::GetMemoryUsage() const {
+        return edges_.capacity() * sizeof(HierarchyEdge) + rank_.capacity() * sizeof(size_t)
+                + (forward_.offsets.capacity() + backward_.offsets.capacity()) * sizeof(size_t)
+                + (forward_.edges.capacity() + backward_.edges.capacity()) * sizeof(EdgeId);
+    }
+
+    template <typename Weight>
+    uint64_t ContractionHierarchyRouter<Weight>::GetSettledVertexCount() const {
+        return settled_count_.load(std::memory_order_relaxed);
+    }
+
+    template <typename Weight>
+    size_t ContractionHierarchyRouter<Weight>::GetShortcutCount() const {
+        return shortcut_count_;
+    }
+
+}  // namespace graph
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace counting_resource {
+
+    /**
+     * Ресурс памяти, который передаёт запросы вышестоящему ресурсу и считает их.
+     * Используется в бенчмарке и тестах, чтобы видеть, сколько выделений делает справочник.
+     */
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+            : upstream_(upstream) {
+        }
+
+        size_t GetAllocationCount() const {
+            return allocation_count_;
+        }
+
+        size_t GetDeallocationCount() const {
+            return deallocation_count_;
+        }
+
+        size_t GetBytesAllocated() const {
+            return bytes_allocated_;
+        }
+
+        size_t GetBytesInUse() const {
+            return bytes_in_use_;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            void* result = upstream_->allocate(bytes, alignment);
+            ++allocation_count_;
+            bytes_allocated_ += bytes;
+            bytes_in_use_ += bytes;
+            return result;
+        }
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+            upstream_->deallocate(pointer, bytes, alignment);
+            ++deallocation_count_;
+            bytes_in_use_ -= bytes;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource* upstream_;
+        size_t allocation_count_ = 0;
+        size_t deallocation_count_ = 0;
+        size_t bytes_allocated_ = 0;
+        size_t bytes_in_use_ = 0;
+    };
+
+}
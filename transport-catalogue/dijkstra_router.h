@@ -0,0 +1,501 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    /**
+     * Дерево кратчайших путей с корнем root.
+     * FORWARD — пути из корня во все вершины, edges[v] — последнее ребро пути в v.
+     * BACKWARD — пути из всех вершин в корень, edges[v] — первое ребро пути из v.
+     */
+    template <typename Weight>
+    struct ShortestPathTree {
+        enum class Direction {
+            FORWARD,
+            BACKWARD
+        };
+
+        static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();     // У корня
+        static constexpr EdgeId UNREACHED = std::numeric_limits<EdgeId>::max() - 1;
+
+        VertexId root = 0;
+        Direction direction = Direction::FORWARD;
+        std::vector<Weight> weights;
+        std::vector<EdgeId> edges;
+
+        size_t GetMemoryUsage() const {
+            return sizeof(*this) + weights.capacity() * sizeof(Weight) + edges.capacity() * sizeof(EdgeId);
+        }
+
+        // Путь между корнем и vertex в направлении дерева
+        std::optional<typename RouterBase<Weight>::RouteInfo> BuildRoute(const DirectedWeightedGraph<Weight>& graph,
+                                                                         VertexId vertex) const {
+            if (edges.at(vertex) == UNREACHED) {
+                return std::nullopt;
+            }
+            std::vector<EdgeId> route;
+            if (direction == Direction::FORWARD) {
+                for (VertexId current = vertex; edges[current] != NO_EDGE; current = graph.GetEdge(edges[current]).from) {
+                    route.push_back(edges[current]);
+                }
+                std::reverse(route.begin(), route.end());
+            } else {
+                for (VertexId current = vertex; edges[current] != NO_EDGE; current = graph.GetEdge(edges[current]).to) {
+                    route.push_back(edges[current]);
+                }
+            }
+            return typename RouterBase<Weight>::RouteInfo{weights[vertex], std::move(route)};
+        }
+    };
+
+    /**
+     * Дейкстра по запросу: в конструкторе только проверка весов, собственной памяти алгоритму не нужно.
+     * Каждый BuildRoute — Дейкстра с двоичной кучей из вершины from с остановкой, как только извлечена вершина to.
+     *
+     * Рабочие массивы (расстояния, рёбра-предшественники, куча) берутся из рабочего пространства потока
+     * и переиспользуются между запросами и маршрутизаторами. Вместо очистки массивов перед запросом
+     * увеличивается номер запроса: значение вершины действительно, только если её метка равна текущему номеру.
+     * Поэтому BuildRoute можно вызывать одновременно из нескольких потоков.
+     *
+     * BuildTree строит полное дерево кратчайших путей, обратное дерево — по входящим рёбрам графа.
+     */
+    template <typename Weight>
+    class DijkstraRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using typename RouterBase<Weight>::RouteInfo;
+        using Tree = ShortestPathTree<Weight>;
+
+        explicit DijkstraRouter(const Graph& graph);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+        size_t GetMemoryUsage() const override;
+        uint64_t GetSettledVertexCount() const override;
+        Tree BuildTree(VertexId root, typename Tree::Direction direction) const;
+
+    protected:
+        /**
+         * Поиск из from до to: вершины извлекаются из кучи по весу пути плюс lower_bound(vertex) —
+         * оценке снизу оставшегося пути до to. С нулевой оценкой это обычная Дейкстра, с ненулевой — A*.
+         * Оценка должна быть согласованной: lower_bound(u) <= вес(u -> v) + lower_bound(v) для каждого ребра,
+         * тогда первое извлечение вершины окончательно и найденный путь кратчайший.
+         */
+        template <typename LowerBound>
+        std::optional<RouteInfo> Search(VertexId from, VertexId to, const LowerBound& lower_bound) const;
+
+    private:
+        struct HeapEntry {
+            Weight weight;
+            VertexId vertex;
+
+            bool operator>(const HeapEntry& other) const {
+                return weight > other.weight;
+            }
+        };
+
+        struct Workspace {
+            std::vector<Weight> weights;
+            std::vector<EdgeId> prev_edges;
+            std::vector<uint32_t> marks;    // Номер запроса, в котором вершина была достигнута
+            std::vector<uint32_t> settled;  // Номер запроса, в котором вершина была извлечена из кучи
+            std::vector<HeapEntry> heap;
+            uint32_t query = 0;
+
+            // Готовит массивы к новому запросу по графу из vertex_count вершин
+            void Prepare(size_t vertex_count) {
+                if (marks.size() < vertex_count) {
+                    weights.resize(vertex_count);
+                    prev_edges.resize(vertex_count);
+                    marks.resize(vertex_count, 0);
+                    settled.resize(vertex_count, 0);
+                }
+                if (++query == 0) {
+                    std::fill(marks.begin(), marks.end(), 0);
+                    std::fill(settled.begin(), settled.end(), 0);
+                    query = 1;
+                }
+                heap.clear();
+            }
+        };
+
+        static Workspace& GetWorkspace() {
+            thread_local Workspace workspace;
+            return workspace;
+        }
+
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+        const Graph& graph_;
+        mutable std::atomic<uint64_t> settled_count_ = 0;
+    };
+
+    /**
+     * A*: поиск DijkstraRouter, направленный к цели. lower_bound(vertex, to) — согласованная оценка снизу
+     * веса пути из vertex в to (см. DijkstraRouter::Search). Чем она точнее, тем меньше вершин извлекается.
+     */
+    template <typename Weight, typename LowerBound>
+    class AStarRouter : public DijkstraRouter<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using typename RouterBase<Weight>::RouteInfo;
+
+        AStarRouter(const Graph& graph, LowerBound lower_bound);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    private:
+        LowerBound lower_bound_;
+    };
+
+    /**
+     * Двунаправленная Дейкстра без предобработки: прямой поиск из from по исходящим рёбрам и обратный
+     * из to по входящим (DirectedWeightedGraph::GetIncomingEdges). Каждый шаг продвигает поиск с меньшим
+     * минимумом в куче; при каждом улучшении вершины, уже достигнутой другим поиском, обновляется лучший
+     * путь через неё. Поиск останавливается, когда сумма минимумов обеих куч не меньше лучшего пути:
+     * более короткий путь прошёл бы через вершину, ещё не извлечённую ни одним из поисков.
+     * Каждый поиск доходит примерно до половины расстояния, поэтому извлекается заметно меньше вершин.
+     * Рабочие массивы, как у DijkstraRouter, берутся из рабочего пространства потока.
+     */
+    template <typename Weight>
+    class BidirectionalDijkstraRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using typename RouterBase<Weight>::RouteInfo;
+
+        explicit BidirectionalDijkstraRouter(const Graph& graph);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+        size_t GetMemoryUsage() const override;
+        uint64_t GetSettledVertexCount() const override;
+
+    private:
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+
+        struct HeapEntry {
+            Weight weight;
+            VertexId vertex;
+
+            bool operator>(const HeapEntry& other) const {
+                return weight > other.weight;
+            }
+        };
+
+        struct SearchSpace {
+            std::vector<Weight> weights;
+            std::vector<EdgeId> prev_edges; // У прямого поиска — ребро в вершину, у обратного — ребро из неё
+            std::vector<uint32_t> marks;
+            std::vector<HeapEntry> heap;
+        };
+
+        struct Workspace {
+            SearchSpace forward;
+            SearchSpace backward;
+            uint32_t query = 0;
+
+            void Prepare(size_t vertex_count) {
+                for (SearchSpace* space : {&forward, &backward}) {
+                    if (space->marks.size() < vertex_count) {
+                        space->weights.resize(vertex_count);
+                        space->prev_edges.resize(vertex_count);
+                        space->marks.resize(vertex_count, 0);
+                    }
+                    space->heap.clear();
+                }
+                if (++query == 0) {
+                    std::fill(forward.marks.begin(), forward.marks.end(), 0);
+                    std::fill(backward.marks.begin(), backward.marks.end(), 0);
+                    query = 1;
+                }
+            }
+        };
+
+        static Workspace& GetWorkspace() {
+            thread_local Workspace workspace;
+            return workspace;
+        }
+
+        const Graph& graph_;
+        mutable std::atomic<uint64_t> settled_count_ = 0;
+    };
+
+    template <typename Weight>
+    DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+            : graph_(graph) {
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+    }
+
+    template <typename Weight>
+    typename DijkstraRouter<Weight>::Tree DijkstraRouter<Weight>::BuildTree(VertexId root,
+                                                                            typename Tree::Direction direction) const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        if (root >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        const bool forward = direction == Tree::Direction::FORWARD;
+
+        Tree tree;
+        tree.root = root;
+        tree.direction = direction;
+        tree.weights.assign(vertex_count, ZERO_WEIGHT);
+        tree.edges.assign(vertex_count, Tree::UNREACHED);
+        tree.edges[root] = Tree::NO_EDGE;
+
+        auto& heap = GetWorkspace().heap;
+        heap.clear();
+        heap.push_back({ZERO_WEIGHT, root});
+        const auto relax = [&tree, &heap](VertexId vertex, Weight candidate, EdgeId edge_id) {
+            if (tree.edges[vertex] == Tree::UNREACHED || candidate < tree.weights[vertex]) {
+                tree.weights[vertex] = candidate;
+                tree.edges[vertex] = edge_id;
+                heap.push_back({candidate, vertex});
+                std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+            }
+        };
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+            const HeapEntry entry = heap.back();
+            heap.pop_back();
+            if (tree.weights[entry.vertex] < entry.weight) {
+                continue;
+            }
+            if (forward) {
+                for (const EdgeId edge_id : graph_.GetIncidentEdges(entry.vertex)) {
+                    const auto& edge = graph_.GetEdge(edge_id);
+                    relax(edge.to, entry.weight + edge.weight, edge_id);
+                }
+            } else {
+                for (const EdgeId edge_id : graph_.GetIncomingEdges(entry.vertex)) {
+                    const auto& edge = graph_.GetEdge(edge_id);
+                    relax(edge.from, entry.weight + edge.weight, edge_id);
+                }
+            }
+        }
+        return tree;
+    }
+
+    template <typename Weight>
+    std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                                 VertexId to) const {
+        return Search(from, to, [](VertexId) { return ZERO_WEIGHT; });
+    }
+
+    template <typename Weight>
+    template <typename LowerBound>
+    std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::Search(
+            VertexId from, VertexId to, const LowerBound& lower_bound) const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        Workspace& workspace = GetWorkspace();
+        workspace.Prepare(vertex_count);
+        auto& weights = workspace.weights;
+        auto& prev_edges = workspace.prev_edges;
+        auto& marks = workspace.marks;
+        auto& settled = workspace.settled;
+        auto& heap = workspace.heap;
+        const uint32_t query = workspace.query;
+
+        weights[from] = ZERO_WEIGHT;
+        prev_edges[from] = NO_EDGE;
+        marks[from] = query;
+        heap.push_back({lower_bound(from), from});
+
+        bool reached = false;
+        uint64_t settled_count = 0;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+            const VertexId vertex = heap.back().vertex;
+            heap.pop_back();
+            // Устаревшая запись: при согласованной оценке первое извлечение вершины окончательно
+            if (settled[vertex] == query) {
+                continue;
+            }
+            settled[vertex] = query;
+            ++settled_count;
+            if (vertex == to) {
+                reached = true;
+                break;
+            }
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                const Weight candidate = weights[vertex] + edge.weight;
+                if (marks[edge.to] != query || (settled[edge.to] != query && candidate < weights[edge.to])) {
+                    marks[edge.to] = query;
+                    weights[edge.to] = candidate;
+                    prev_edges[edge.to] = edge_id;
+                    heap.push_back({candidate + lower_bound(edge.to), edge.to});
+                    std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+                }
+            }
+        }
+        settled_count_.fetch_add(settled_count, std::memory_order_relaxed);
+        if (!reached) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (VertexId vertex = to; prev_edges[vertex] != NO_EDGE; vertex = graph_.GetEdge(prev_edges[vertex]).from) {
+            edges.push_back(prev_edges[vertex]);
+        }
+        std::reverse(edges.begin(), edges.end());
+        return RouteInfo{weights[to], std::move(edges)};
+    }
+
+    template <typename Weight>
+    size_t DijkstraRouter<Weight>::GetMemoryUsage() const {
+        return 0;
+    }
+
+    template <typename Weight>
+    uint64_t DijkstraRouter<Weight>::GetSettledVertexCount() const {
+        return settled_count_.load(std::memory_order_relaxed);
+    }
+
+    template <typename Weight, typename LowerBound>
+    AStarRouter<Weight, LowerBound>::AStarRouter(const Graph& graph, LowerBound lower_bound)
+            : DijkstraRouter<Weight>(graph),
+              lower_bound_(std::move(lower_bound)) {
+    }
+
+    template <typename Weight, typename LowerBound>
+    std::optional<typename AStarRouter<Weight, LowerBound>::RouteInfo> AStarRouter<Weight, LowerBound>::BuildRoute(
+            VertexId from, VertexId to) const {
+        return this->Search(from, to, [this, to](VertexId vertex) { return lower_bound_(vertex, to); });
+    }
+
+    template <typename Weight>
+    BidirectionalDijkstraRouter<Weight>::BidirectionalDijkstraRouter(const Graph& graph)
+            : graph_(graph) {
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+    }
+
+    template <typename Weight>
+    std::optional<typename BidirectionalDijkstraRouter<Weight>::RouteInfo> BidirectionalDijkstraRouter<Weight>::BuildRoute(
+            VertexId from, VertexId to) const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (from == to) {
+            return RouteInfo{ZERO_WEIGHT, {}};
+        }
+
+        Workspace& workspace = GetWorkspace();
+        workspace.Prepare(vertex_count);
+        const uint32_t query = workspace.query;
+        SearchSpace& forward = workspace.forward;
+        SearchSpace& backward = workspace.backward;
+        for (auto [space, root] : {std::pair{&forward, from}, std::pair{&backward, to}}) {
+            space->weights[root] = ZERO_WEIGHT;
+            space->prev_edges[root] = NO_EDGE;
+            space->marks[root] = query;
+            space->heap.push_back({ZERO_WEIGHT, root});
+        }
+
+        std::optional<Weight> best;
+        VertexId meeting = from;
+        uint64_t settled_count = 0;
+        while (!forward.heap.empty() && !backward.heap.empty()) {
+            const Weight forward_min = forward.heap.front().weight;
+            const Weight backward_min = backward.heap.front().weight;
+            if (best && !(forward_min + backward_min < *best)) {
+                break;
+            }
+            const bool is_forward = !(backward_min < forward_min);
+            SearchSpace& space = is_forward ? forward : backward;
+            const SearchSpace& other = is_forward ? backward : forward;
+
+            std::pop_heap(space.heap.begin(), space.heap.end(), std::greater<>{});
+            const HeapEntry entry = space.heap.back();
+            space.heap.pop_back();
+            if (space.weights[entry.vertex] < entry.weight) {
+                continue;
+            }
+            ++settled_count;
+
+            const auto relax = [&](VertexId next, EdgeId edge_id, Weight edge_weight) {
+                const Weight candidate = entry.weight + edge_weight;
+                if (space.marks[next] == query && !(candidate < space.weights[next])) {
+                    return;
+                }
+                space.marks[next] = query;
+                space.weights[next] = candidate;
+                space.prev_edges[next] = edge_id;
+                space.heap.push_back({candidate, next});
+                std::push_heap(space.heap.begin(), space.heap.end(), std::greater<>{});
+                if (other.marks[next] == query) {
+                    const Weight total = candidate + other.weights[next];
+                    if (!best || total < *best) {
+                        best = total;
+                        meeting = next;
+                    }
+                }
+            };
+            if (is_forward) {
+                for (const EdgeId edge_id : graph_.GetIncidentEdges(entry.vertex)) {
+                    const auto& edge = graph_.GetEdge(edge_id);
+                    relax(edge.to, edge_id, edge.weight);
+                }
+            } else {
+                for (const EdgeId edge_id : graph_.GetIncomingEdges(entry.vertex)) {
+                    const auto& edge = graph_.GetEdge(edge_id);
+                    relax(edge.from, edge_id, edge.weight);
+                }
+            }
+        }
+        settled_count_.fetch_add(settled_count, std::memory_order_relaxed);
+        if (!best) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (VertexId vertex = meeting; forward.prev_edges[vertex] != NO_EDGE; vertex = graph_.GetEdge(forward.prev_edges[vertex]).from) {
+            edges.push_back(forward.prev_edges[vertex]);
+        }
+        std::reverse(edges.begin(), edges.end());
+        for (VertexId vertex = meeting; backward.prev_edges[vertex] != NO_EDGE; vertex = graph_.GetEdge(backward.prev_edges[vertex]).to) {
+            edges.push_back(backward.prev_edges[vertex]);
+        }
+        return RouteInfo{*best, std::move(edges)};
+    }
+
+    template <typename Weight>
+    size_t BidirectionalDijkstraRouter<Weight>::GetMemoryUsage() const {
+        return 0;
+    }
+
+    template <typename Weight>
+    uint64_t BidirectionalDijkstraRouter<Weight>::GetSettledVertexCount() const {
+        return settled_count_.load(std::memory_order_relaxed);
+    }
+
+}  // namespace graph
@@ -7,6 +7,9 @@
 #include "memory"
 #include "map"
 #include "set"
+#include <cstddef>
+#include <iterator>
+#include <memory_resource>
 
 namespace domain{
 
@@ -45,18 +48,81 @@ struct Stop{
 
         Stop() = default;
 
-        Stop(const std::string& stop_name, const geo::Coordinates& coordinates)
-                :name(stop_name), coordinates(coordinates){}
+        // Имя размещается в resource (в справочнике — его арена)
+        Stop(std::string_view stop_name, const geo::Coordinates& coordinates,
+             std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+                :name(stop_name, resource), coordinates(coordinates){}
 
-        std::string name;
+        std::pmr::string name;
         geo::Coordinates coordinates;
+        size_t id = 0; // Порядковый номер остановки в справочнике, назначается при добавлении
     };
 
     struct Bus{
-        std::string name;
-        std::vector<const Stop*> stop;
+        Bus() = default;
+        // Имя и массивы маршрута размещаются в resource (арена справочника)
+        explicit Bus(std::pmr::memory_resource* resource)
+                : name(resource), stop(resource), road_distance_forward(resource), road_distance_backward(resource), geo_distance(resource) {}
+
+        std::pmr::string name;
+        // Остановки в том виде, как заданы: для некольцевого маршрута только путь в одну сторону,
+        // полный маршрут даёт RouteView
+        std::pmr::vector<const Stop*> stop;
         bool ring_route = false; // Признак колцевого маршрута
         size_t unique_stops_count = 0;
+        size_t id = 0; // Порядковый номер маршрута в справочнике, назначается при добавлении
+        // Накопленные суммы вдоль stop: [i] — сумма по перегонам 0..i-1, размер равен stop.size()
+        std::pmr::vector<uint32_t> road_distance_forward;  // Дорожное расстояние stop[m] -> stop[m+1]
+        std::pmr::vector<uint32_t> road_distance_backward; // Дорожное расстояние stop[m+1] -> stop[m]
+        std::pmr::vector<double> geo_distance;             // Географическое расстояние между stop[m] и stop[m+1]
+    };
+
+    /**
+     * Полная последовательность остановок маршрута без хранения её копии.
+     * Для кольцевого маршрута это Bus::stop как есть, для некольцевого A-B-C — A-B-C-B-A.
+     */
+    class RouteView{
+    public:
+        class Iterator{
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = const Stop*;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = value_type;
+
+            Iterator(const RouteView& view, size_t index) : view_(&view), index_(index) {}
+
+            value_type operator*() const { return (*view_)[index_]; }
+            Iterator& operator++() { ++index_; return *this; }
+            Iterator operator++(int) { Iterator tmp = *this; ++index_; return tmp; }
+            bool operator==(const Iterator& other) const { return index_ == other.index_; }
+            bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+        private:
+            const RouteView* view_;
+            size_t index_;
+        };
+
+        explicit RouteView(const Bus& bus) : bus_(bus) {}
+
+        size_t size() const {
+            const size_t stored = bus_.stop.size();
+            return bus_.ring_route || stored == 0 ? stored : 2 * stored - 1;
+        }
+
+        // Индекс в Bus::stop, соответствующий позиции index полного маршрута
+        size_t StoredIndex(size_t index) const {
+            const size_t stored = bus_.stop.size();
+            return index < stored ? index : 2 * (stored - 1) - index;
+        }
+
+        const Stop* operator[](size_t index) const { return bus_.stop[StoredIndex(index)]; }
+        Iterator begin() const { return Iterator(*this, 0); }
+        Iterator end() const { return Iterator(*this, size()); }
+
+    private:
+        const Bus& bus_;
     };
 
     struct BusInfo{
@@ -66,4 +132,10 @@ struct Stop{
         bool found = false;
         double curvature;
     };
+
+    // Остановка, найденная поиском по окрестности точки
+    struct NearbyStop{
+        const Stop* stop = nullptr;
+        double distance = 0.0; // Расстояние от точки запроса в метрах
+    };
 }
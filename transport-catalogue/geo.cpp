@@ -0,0 +1,87 @@
+#include "geo.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEO_HAS_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+namespace geo {
+
+    namespace {
+        struct UnitVector {
+            double x;
+            double y;
+            double z;
+        };
+
+        UnitVector ToUnitVector(const Coordinates& coordinates) {
+            const double lat = coordinates.lat * DEG_TO_RAD;
+            const double lng = coordinates.lng * DEG_TO_RAD;
+            return {std::cos(lat) * std::cos(lng), std::cos(lat) * std::sin(lng), std::sin(lat)};
+        }
+
+#ifdef GEO_HAS_AVX2_KERNEL
+        // Собирается с AVX2 независимо от флагов сборки, вызывается, только если процессор его поддерживает.
+        // Возвращает число обработанных точек, кратное четырём
+        __attribute__((target("avx2")))
+        size_t ComputeCosinesAvx2(const UnitVector& c, const double* x, const double* y, const double* z, std::span<double> out) {
+            const __m256d cx = _mm256_set1_pd(c.x);
+            const __m256d cy = _mm256_set1_pd(c.y);
+            const __m256d cz = _mm256_set1_pd(c.z);
+            size_t i = 0;
+            for (; i + 4 <= out.size(); i += 4) {
+                const __m256d dot = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(cx, _mm256_loadu_pd(x + i)), _mm256_mul_pd(cy, _mm256_loadu_pd(y + i))),
+                                                  _mm256_mul_pd(cz, _mm256_loadu_pd(z + i)));
+                _mm256_storeu_pd(out.data() + i, dot);
+            }
+            return i;
+        }
+
+        bool CpuSupportsAvx2() {
+            static const bool supported = __builtin_cpu_supports("avx2");
+            return supported;
+        }
+#endif
+    }
+
+    void CoordinatesBatch::Clear() {
+        x_.clear();
+        y_.clear();
+        z_.clear();
+    }
+
+    void CoordinatesBatch::Reserve(size_t size) {
+        x_.reserve(size);
+        y_.reserve(size);
+        z_.reserve(size);
+    }
+
+    void CoordinatesBatch::Add(const Coordinates& coordinates) {
+        const UnitVector vector = ToUnitVector(coordinates);
+        x_.push_back(vector.x);
+        y_.push_back(vector.y);
+        z_.push_back(vector.z);
+    }
+
+    size_t CoordinatesBatch::Size() const {
+        return x_.size();
+    }
+
+    void CoordinatesBatch::ComputeCosinesScalar(const Coordinates& center, size_t first, std::span<double> out) const {
+        const UnitVector c = ToUnitVector(center);
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] = c.x * x_[first + i] + c.y * y_[first + i] + c.z * z_[first + i];
+        }
+    }
+
+    void CoordinatesBatch::ComputeCosines(const Coordinates& center, size_t first, std::span<double> out) const {
+        size_t i = 0;
+#ifdef GEO_HAS_AVX2_KERNEL
+        if (CpuSupportsAvx2()) {
+            i = ComputeCosinesAvx2(ToUnitVector(center), x_.data() + first, y_.data() + first, z_.data() + first, out);
+        }
+#endif
+        ComputeCosinesScalar(center, first + i, out.subspan(i));
+    }
+
+}
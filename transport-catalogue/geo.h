@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cmath>
+#include <span>
 #include <stdint.h>
+#include <vector>
 
 namespace geo {
 
@@ -20,15 +22,119 @@ namespace geo {
             }
     };
 
+    /**
+     * Компактное представление координат в снимке (serialization::CoordinateFormat::MICRODEGREES):
+     * целые микроградусы, 8 байт вместо 16. В памяти справочника и при отрисовке координаты — double.
+     * Точность — 1e-6 градуса (не хуже 0.12 м на местности); координаты, заданные
+     * не более чем шестью знаками после запятой, восстанавливаются без потерь.
+     */
+    struct CompactCoordinates {
+        int32_t lat_e6 = 0;
+        int32_t lng_e6 = 0;
+
+        bool operator==(CompactCoordinates const &other) const {
+            return lat_e6 == other.lat_e6 && lng_e6 == other.lng_e6;
+        }
+    };
+
+    constexpr double COMPACT_COORDINATES_SCALE = 1e6;
+
+    inline CompactCoordinates Encode(const Coordinates& coordinates) {
+        return {static_cast<int32_t>(std::lround(coordinates.lat * COMPACT_COORDINATES_SCALE)),
+                static_cast<int32_t>(std::lround(coordinates.lng * COMPACT_COORDINATES_SCALE))};
+    }
+
+    inline Coordinates Decode(const CompactCoordinates& coordinates) {
+        return {coordinates.lat_e6 / COMPACT_COORDINATES_SCALE, coordinates.lng_e6 / COMPACT_COORDINATES_SCALE};
+    }
+
+    constexpr double DEG_TO_RAD = 3.1415926535 / 180.;
+
     inline double ComputeDistance(const Coordinates& from, const Coordinates& to) {
         using namespace std;
         if (from == to) {
             return 0;
         }
-        static const double dr = 3.1415926535 / 180.;
+        static const double dr = DEG_TO_RAD;
         return acos(sin(from.lat * dr) * sin(to.lat * dr)
                     + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
             * radius_earth;
     }
 
+    /**
+     * Способ расчёта расстояний между точками.
+     * PRECISE — сферическая теорема косинусов (ComputeDistance), используется для ответов Bus.
+     * EQUIRECTANGULAR — равнопромежуточная проекция со средней широтой пары: одна тригонометрическая функция
+     * вместо четырёх. Относительная погрешность против расстояния по большому кругу на широтах до 70°:
+     * не больше 1e-6 для расстояний до 10 км, 3e-5 — до 50 км, 1e-4 — до 100 км; растёт примерно
+     * квадратично с расстоянием и быстро — у полюсов и при переходе через 180-й меридиан.
+     */
+    enum class DistanceMode {
+        PRECISE,
+        EQUIRECTANGULAR
+    };
+
+    inline double ComputeEquirectangularDistance(const Coordinates& from, const Coordinates& to) {
+        const double x = (to.lng - from.lng) * DEG_TO_RAD * std::cos((from.lat + to.lat) / 2 * DEG_TO_RAD);
+        const double y = (to.lat - from.lat) * DEG_TO_RAD;
+        return std::sqrt(x * x + y * y) * radius_earth;
+    }
+
+    inline double ComputeDistance(const Coordinates& from, const Coordinates& to, DistanceMode mode) {
+        return mode == DistanceMode::PRECISE ? ComputeDistance(from, to) : ComputeEquirectangularDistance(from, to);
+    }
+
+    // Точка с заранее посчитанными синусом и косинусом широты
+    struct PrecomputedCoordinates {
+        Coordinates coordinates;
+        double sin_lat = 0.0;
+        double cos_lat = 0.0;
+    };
+
+    inline PrecomputedCoordinates Precompute(const Coordinates& coordinates) {
+        return {coordinates, std::sin(coordinates.lat * DEG_TO_RAD), std::cos(coordinates.lat * DEG_TO_RAD)};
+    }
+
+    // То же, что ComputeDistance (результат совпадает до бита), но без sin и cos широт на каждую пару
+    inline double ComputeDistance(const PrecomputedCoordinates& from, const PrecomputedCoordinates& to) {
+        using namespace std;
+        if (from.coordinates == to.coordinates) {
+            return 0;
+        }
+        return acos(from.sin_lat * to.sin_lat
+                    + from.cos_lat * to.cos_lat * cos(abs(from.coordinates.lng - to.coordinates.lng) * DEG_TO_RAD))
+            * radius_earth;
+    }
+
+    /**
+     * Набор точек в раскладке SoA: координаты единичных векторов лежат в трёх отдельных массивах.
+     * Косинус центрального угла между точкой и центром — скалярное произведение векторов,
+     * поэтому для пакета точек он считается без тригонометрии. На x86 векторный вариант собирается всегда,
+     * а выбирается при запуске: если процессор поддерживает AVX2, точки считаются по четыре за раз.
+     * Используется только для предварительного отбора в StopGrid::FindNearby; расстояния по маршрутам
+     * (извилистость) и границы проекции карты считаются скалярно.
+     */
+    class CoordinatesBatch {
+    public:
+        void Clear();
+        void Reserve(size_t size);
+        void Add(const Coordinates& coordinates);
+        size_t Size() const;
+
+        // out[i] = косинус центрального угла между center и точкой first + i, out.size() точек
+        void ComputeCosines(const Coordinates& center, size_t first, std::span<double> out) const;
+        // Скалярный вариант, используется для хвостов и для проверки векторного
+        void ComputeCosinesScalar(const Coordinates& center, size_t first, std::span<double> out) const;
+
+    private:
+        std::vector<double> x_;
+        std::vector<double> y_;
+        std::vector<double> z_;
+    };
+
+    // Косинус центрального угла для расстояния distance по поверхности Земли
+    inline double CosineOfDistance(double distance) {
+        return std::cos(distance / radius_earth);
+    }
+
 }
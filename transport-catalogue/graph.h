@@ -2,7 +2,13 @@
 
 #include "ranges.h"
 
+#include <cassert>
+#include <cstdint>
 #include <cstdlib>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace graph {
@@ -27,64 +33,208 @@ namespace graph {
 //    };
 
     template <typename Weight>
+    class GraphBuilder;
+
+    /**
+     * Неизменяемый граф в формате CSR (compressed sparse row). Рёбра упорядочены по исходящей вершине,
+     * id ребра — его позиция в этом порядке, поэтому исходящие рёбра вершины v — отрезок id
+     * [offsets_[v], offsets_[v + 1]), а их концы и веса лежат подряд в отдельных массивах.
+     * Входящие рёбра — такой же отрезок в in_edges_. Вершины и рёбра хранятся 32-битными номерами.
+     * Строится через GraphBuilder.
+     */
+    template <typename Weight>
     class DirectedWeightedGraph {
     private:
-        using IncidenceList = std::vector<EdgeId>;
-        using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+        using CompactId = uint32_t;
+        using IncidentEdgesRange = std::ranges::iota_view<EdgeId, EdgeId>;
+        using IncomingEdgesRange = ranges::Range<typename std::vector<CompactId>::const_iterator>;
 
     public:
         DirectedWeightedGraph() = default;
+        // Граф из vertex_count вершин без рёбер
         explicit DirectedWeightedGraph(size_t vertex_count);
-        DirectedWeightedGraph(std::vector<Edge<Weight>>&& edges, std::vector<IncidenceList>&& incidence_lists);
-        EdgeId AddEdge(const Edge<Weight>& edge);
 
         size_t GetVertexCount() const;
         size_t GetEdgeCount() const;
-        const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+        Edge<Weight> GetEdge(EdgeId edge_id) const;
         IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+        // Рёбра, входящие в вершину: для поиска по обратному графу
+        IncomingEdgesRange GetIncomingEdges(VertexId vertex) const;
+        size_t GetMemoryUsage() const;
+
+    private:
+        friend class GraphBuilder<Weight>;
+
+        std::vector<CompactId> offsets_ = {0};    // По вершине: первое исходящее ребро, в конце — число рёбер
+        std::vector<CompactId> sources_;          // По ребру
+        std::vector<CompactId> targets_;          // По ребру
+        std::vector<Weight> weights_;             // По ребру
+        std::vector<CompactId> in_offsets_ = {0}; // По вершине: начало её входящих рёбер в in_edges_
+        std::vector<CompactId> in_edges_;
+    };
+
+    /**
+     * Двухпроходное построение DirectedWeightedGraph: AddEdge запоминает ребро и считает степени вершин,
+     * Build по степеням раскладывает рёбра в массивы CSR без перевыделений.
+     * Исходящие рёбра вершины сохраняют порядок добавления, но id ребра в графе — его позиция в CSR,
+     * а не порядковый номер добавления; соответствие дают GetEdgeId и Reorder.
+     */
+    template <typename Weight>
+    class GraphBuilder {
+    public:
+        explicit GraphBuilder(size_t vertex_count);
+
+        // Порядковый номер добавленного ребра, начиная с 0
+        size_t AddEdge(const Edge<Weight>& edge);
+        size_t GetEdgeCount() const;
+
+        // Строит граф; сами рёбра из построителя после этого удаляются
+        DirectedWeightedGraph<Weight> Build();
+        // id в построенном графе ребра, добавленного под номером added
+        EdgeId GetEdgeId(size_t added) const;
+        // Переставляет данные рёбер из порядка добавления в порядок id построенного графа
+        template <typename T>
+        std::vector<T> Reorder(std::vector<T>&& by_addition) const;
 
     private:
+        using CompactId = typename DirectedWeightedGraph<Weight>::CompactId;
+
+        size_t vertex_count_;
         std::vector<Edge<Weight>> edges_;
-        std::vector<IncidenceList> incidence_lists_;
+        std::vector<size_t> out_degrees_;
+        std::vector<size_t> in_degrees_;
+        std::vector<EdgeId> edge_ids_; // По номеру добавления, заполняется в Build
     };
 
     template <typename Weight>
     DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-            : incidence_lists_(vertex_count) {
+            : offsets_(vertex_count + 1, 0),
+              in_offsets_(vertex_count + 1, 0) {
     }
 
     template <typename Weight>
-    DirectedWeightedGraph<Weight>::DirectedWeightedGraph(std::vector<Edge<Weight>>&& edges, std::vector<IncidenceList>&& incidence_lists)
-            : edges_(edges), incidence_lists_(incidence_lists) {
+    size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
+        return offsets_.size() - 1;
     }
 
     template <typename Weight>
-    EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
-        edges_.push_back(edge);
-        const EdgeId id = edges_.size() - 1;
-        incidence_lists_.at(edge.from).push_back(id);
-        return id;
+    size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
+        return targets_.size();
     }
 
     template <typename Weight>
-    size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-        return incidence_lists_.size();
+    Edge<Weight> DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+        assert(edge_id < targets_.size());
+        return {sources_[edge_id], targets_[edge_id], weights_[edge_id]};
     }
 
     template <typename Weight>
-    size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
+    typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
+    DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
+        assert(vertex + 1 < offsets_.size());
+        return IncidentEdgesRange{offsets_[vertex], offsets_[vertex + 1]};
+    }
+
+    template <typename Weight>
+    typename DirectedWeightedGraph<Weight>::IncomingEdgesRange
+    DirectedWeightedGraph<Weight>::GetIncomingEdges(VertexId vertex) const {
+        assert(vertex + 1 < in_offsets_.size());
+        return {in_edges_.begin() + in_offsets_[vertex], in_edges_.begin() + in_offsets_[vertex + 1]};
+    }
+
+    template <typename Weight>
+    size_t DirectedWeightedGraph<Weight>::GetMemoryUsage() const {
+        return (offsets_.capacity() + sources_.capacity() + targets_.capacity()
+                + in_offsets_.capacity() + in_edges_.capacity()) * sizeof(CompactId)
+                + weights_.capacity() * sizeof(Weight);
+    }
+
+    template <typename Weight>
+    GraphBuilder<Weight>::GraphBuilder(size_t vertex_count)
+            : vertex_count_(vertex_count),
+              out_degrees_(vertex_count, 0),
+              in_degrees_(vertex_count, 0) {
+    }
+
+    template <typename Weight>
+    size_t GraphBuilder<Weight>::AddEdge(const Edge<Weight>& edge) {
+        if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        edges_.push_back(edge);
+        ++out_degrees_[edge.from];
+        ++in_degrees_[edge.to];
+        return edges_.size() - 1;
+    }
+
+    template <typename Weight>
+    size_t GraphBuilder<Weight>::GetEdgeCount() const {
         return edges_.size();
     }
 
     template <typename Weight>
-    const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
-        return edges_.at(edge_id);
+    DirectedWeightedGraph<Weight> GraphBuilder<Weight>::Build() {
+        if (vertex_count_ >= std::numeric_limits<CompactId>::max() || edges_.size() >= std::numeric_limits<CompactId>::max()) {
+            throw std::length_error("Graph is too large for 32-bit vertex and edge ids");
+        }
+        DirectedWeightedGraph<Weight> graph;
+        graph.offsets_.assign(vertex_count_ + 1, 0);
+        graph.in_offsets_.assign(vertex_count_ + 1, 0);
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            graph.offsets_[vertex + 1] = graph.offsets_[vertex] + static_cast<CompactId>(out_degrees_[vertex]);
+            graph.in_offsets_[vertex + 1] = graph.in_offsets_[vertex] + static_cast<CompactId>(in_degrees_[vertex]);
+        }
+
+        const size_t edge_count = edges_.size();
+        graph.sources_.resize(edge_count);
+        graph.targets_.resize(edge_count);
+        graph.weights_.resize(edge_count);
+        edge_ids_.resize(edge_count);
+        // Степени больше не нужны: в них теперь позиция следующего ребра вершины
+        std::vector<size_t>& next_out = out_degrees_;
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            next_out[vertex] = graph.offsets_[vertex];
+        }
+        for (size_t added = 0; added < edge_count; ++added) {
+            const Edge<Weight>& edge = edges_[added];
+            const EdgeId id = next_out[edge.from]++;
+            edge_ids_[added] = id;
+            graph.sources_[id] = static_cast<CompactId>(edge.from);
+            graph.targets_[id] = static_cast<CompactId>(edge.to);
+            graph.weights_[id] = edge.weight;
+        }
+
+        graph.in_edges_.resize(edge_count);
+        std::vector<size_t>& next_in = in_degrees_;
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            next_in[vertex] = graph.in_offsets_[vertex];
+        }
+        for (EdgeId id = 0; id < edge_count; ++id) {
+            graph.in_edges_[next_in[graph.targets_[id]]++] = static_cast<CompactId>(id);
+        }
+
+        edges_ = {};
+        out_degrees_ = {};
+        in_degrees_ = {};
+        return graph;
     }
 
     template <typename Weight>
-    typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
-    DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-        return ranges::AsRange(incidence_lists_.at(vertex));
+    EdgeId GraphBuilder<Weight>::GetEdgeId(size_t added) const {
+        return edge_ids_.at(added);
+    }
+
+    template <typename Weight>
+    template <typename T>
+    std::vector<T> GraphBuilder<Weight>::Reorder(std::vector<T>&& by_addition) const {
+        if (by_addition.size() != edge_ids_.size()) {
+            throw std::invalid_argument("Edge data size does not match the built graph");
+        }
+        std::vector<T> by_id(by_addition.size());
+        for (size_t added = 0; added < by_addition.size(); ++added) {
+            by_id[edge_ids_[added]] = std::move(by_addition[added]);
+        }
+        return by_id;
     }
 
 }  // namespace graph
@@ -107,18 +107,15 @@ void ParseStopDistance(transport_catalogue::TransportCatalogue &catalogue, const
 /**
  * Парсит маршрут.
  * Для кольцевого маршрута (A>B>C>A) возвращает массив названий остановок [A,B,C,A]
- * Для некольцевого маршрута (A-B-C-D) возвращает массив названий остановок [A,B,C,D,C,B,A]
+ * Для некольцевого маршрута (A-B-C-D) возвращает массив названий остановок [A,B,C,D]
  */
 std::vector<std::string_view> ParseRoute(std::string_view route) {
     if (route.find('>') != route.npos) {
         return Split(route, '>');
     }
 
-    auto stops = Split(route, '-');
-    std::vector<std::string_view> results(stops.begin(), stops.end()); // @suppress("Invalid arguments")
-    results.insert(results.end(), std::next(stops.rbegin()), stops.rend()); // @suppress("Invalid arguments")
-
-    return results;
+    // Обратный путь некольцевого маршрута справочник строит сам
+    return Split(route, '-');
 }
 
 input_reader::CommandDescription ParseCommandDescription(
@@ -181,6 +178,8 @@ void InputReader::ApplyCommands(
             catalogue.AddBus(it.id, ParseRoute(it.description), ring_route); // @suppress("Invalid arguments") // @suppress("Field cannot be resolved")
         }
     }
+
+    catalogue.Freeze();
 }
 
 void InputReader::InsertCommands(std::istringstream &command,
@@ -21,11 +21,17 @@ namespace jsonreader
           }
           else if(key == "routing_settings"s){
               settings_output.routing_settings = GetRoutingSettings(value.AsMap());
-              router_ = {settings_output.routing_settings, std::make_unique<transport_catalogue::TransportCatalogue>(transport_catalogue_)};
+              // Ключи разбираются по алфавиту: база к этому моменту уже загружена
+              if (HasRouteRequests(map)) {
+                  BuildRouter(settings_output.routing_settings);
+              }
           }
           else if(key == "render_settings"s){
               settings_output.render_settings = GetSettingsRender(value.AsMap()); // @suppress("Invalid arguments") // @suppress("Method cannot be resolved")
           }
+          else if(key == "search_settings"s){
+              distance_mode_ = GetDistanceMode(value.AsMap());
+          }
 
       }
 
@@ -33,10 +39,73 @@ namespace jsonreader
 
     }
 
+    void JsonReader::MakeBase(std::istream& input_json){
+        using namespace std::literals;
+        json::Document doc = json::Load(input_json);
+        const json::Dict& map = doc.GetRoot().AsMap();
+
+        SettingsOutput settings_output;
+        serialization::SerializationSettings serialization_settings;
+
+        for(const auto& [key, value]: map){
+            if(key == "base_requests"s){
+                ProcessBaseRequest(value.AsArray());
+            }
+            else if(key == "routing_settings"s){
+                settings_output.routing_settings = GetRoutingSettings(value.AsMap());
+            }
+            else if(key == "render_settings"s){
+                settings_output.render_settings = GetSettingsRender(value.AsMap());
+            }
+            else if(key == "serialization_settings"s){
+                serialization_settings = GetSerializationSettings(value.AsMap());
+            }
+        }
+
+        std::ofstream out(serialization_settings.file, std::ios::binary);
+        if (!out) {
+            throw serialization::SerializationError("Cannot open "s + serialization_settings.file + " for writing"s);
+        }
+        serialization::Serialize(*transport_catalogue_, settings_output.render_settings, settings_output.routing_settings, out,
+                                 serialization_settings.coordinate_format);
+        if (!serialization_settings.router_file.empty()) {
+            SaveRouter(settings_output.routing_settings, serialization_settings.router_file);
+        }
+    }
+
+    void JsonReader::ProcessRequests(std::istream& input_json, std::ostream& out){
+        using namespace std::literals;
+        json::Document doc = json::Load(input_json);
+        const json::Dict& map = doc.GetRoot().AsMap();
+
+        SettingsOutput settings_output;
+        const auto serialization_settings = GetSerializationSettings(map.at("serialization_settings"s).AsMap());
+        {
+            const serialization::MappedFile file(serialization_settings.file);
+            const serialization::SnapshotView snapshot(file.Data());
+            serialization::Deserialize(snapshot, *transport_catalogue_, settings_output.render_settings, settings_output.routing_settings);
+        }
+        if (HasRouteRequests(map)) {
+            if (serialization_settings.router_file.empty()) {
+                BuildRouter(settings_output.routing_settings);
+            } else {
+                LoadRouter(settings_output.routing_settings, serialization_settings.router_file);
+            }
+        }
+
+        // Настройки поиска не входят в снимок: режим расстояний выбирается при каждом запуске
+        if (auto it = map.find("search_settings"s); it != map.end()) {
+            distance_mode_ = GetDistanceMode(it->second.AsMap());
+        }
+        if (auto it = map.find("stat_requests"s); it != map.end()) {
+            ProcessStatRequest(it->second.AsArray(), out, settings_output);
+        }
+    }
+
     /**
      * Парсит маршрут.
      * Для кольцевого маршрута (A>B>C>A) возвращает массив названий остановок [A,B,C,A]
-     * Для некольцевого маршрута (A-B-C-D) возвращает массив названий остановок [A,B,C,D,C,B,A]
+     * Для некольцевого маршрута (A-B-C-D) возвращает массив названий остановок [A,B,C,D]
      */
     std::vector<std::string_view> JsonReader::ParseRoute(const json::Array& route, bool is_roundtrip){
         std::vector<std::string_view> results;
@@ -44,16 +113,8 @@ namespace jsonreader
                  for(const auto &stop: route){
                      results.push_back(stop.AsString()); // @suppress("Invalid arguments") // @suppress("Method cannot be resolved")
                  }
-                 if(!is_roundtrip){
-                     std::vector<std::string_view> v_tmp;
-                     std::vector<std::string_view>::reverse_iterator ri;
-                     for (ri = results.rbegin()+1; ri != results.rend(); ++ri ){
-                         v_tmp.push_back(*ri); // @suppress("Invalid arguments")
-                     }
-                    for(auto &item: v_tmp) {
-                        results.push_back(std::move(item)); // @suppress("Invalid arguments")
-                    }
-                 } else{
+                 // Некольцевой маршрут хранится в одну сторону, обратный путь не дописываем
+                 if(is_roundtrip){
                      if (results.size() != 0 && results[results.size()-1] != results[0]) {
                          std::string_view firs_stop = results[0];
                          results.push_back(std::move(firs_stop));
@@ -121,18 +182,78 @@ namespace jsonreader
 
     transport_router::RoutingSettings JsonReader::GetRoutingSettings(const json::Dict& dict){
 
-           return {dict.at("bus_wait_time").AsDouble(),
-                   dict.at("bus_velocity").AsDouble()};
+           transport_router::RoutingSettings settings{dict.at("bus_wait_time").AsDouble(),
+                                                      dict.at("bus_velocity").AsDouble()};
+           if (auto it = dict.find("shard_count"); it != dict.end() && it->second.AsInt() > 1) {
+               settings.shard_count_ = static_cast<size_t>(it->second.AsInt());
+           }
+           // "router_engine": "floyd_warshall" (по умолчанию), "dijkstra", "bidirectional_dijkstra",
+           // "contraction_hierarchies", "a_star" или "raptor"
+           if (auto it = dict.find("router_engine"); it != dict.end()) {
+               if (it->second.AsString() == "dijkstra") {
+                   settings.router_engine_ = transport_router::RouterEngine::DIJKSTRA;
+               } else if (it->second.AsString() == "contraction_hierarchies") {
+                   settings.router_engine_ = transport_router::RouterEngine::CONTRACTION_HIERARCHIES;
+               } else if (it->second.AsString() == "bidirectional_dijkstra") {
+                   settings.router_engine_ = transport_router::RouterEngine::BIDIRECTIONAL_DIJKSTRA;
+               } else if (it->second.AsString() == "a_star") {
+                   settings.router_engine_ = transport_router::RouterEngine::A_STAR;
+               } else if (it->second.AsString() == "raptor") {
+                   settings.router_engine_ = transport_router::RouterEngine::RAPTOR;
+               } else if (it->second.AsString() != "floyd_warshall") {
+                   throw std::invalid_argument("Unknown router_engine: " + it->second.AsString());
+               }
+           }
+           if (auto it = dict.find("route_cache_bytes"); it != dict.end() && it->second.AsInt() > 0) {
+               settings.route_cache_bytes_ = static_cast<size_t>(it->second.AsInt());
+           }
+           if (auto it = dict.find("tree_cache_bytes"); it != dict.end() && it->second.AsInt() > 0) {
+               settings.tree_cache_bytes_ = static_cast<size_t>(it->second.AsInt());
+           }
+           // "graph_model": "stop_pairs" (по умолчанию) или "route_lines"
+           if (auto it = dict.find("graph_model"); it != dict.end()) {
+               if (it->second.AsString() == "route_lines") {
+                   settings.graph_model_ = transport_router::GraphModel::ROUTE_LINES;
+               } else if (it->second.AsString() != "stop_pairs") {
+                   throw std::invalid_argument("Unknown graph_model: " + it->second.AsString());
+               }
+           }
+           return settings;
     }
 
 
+    serialization::SerializationSettings JsonReader::GetSerializationSettings(const json::Dict& dict){
+        serialization::SerializationSettings settings;
+        settings.file = dict.at("file").AsString();
+        if (auto it = dict.find("compact_coordinates"); it != dict.end() && it->second.AsBool()) {
+            settings.coordinate_format = serialization::CoordinateFormat::MICRODEGREES;
+        }
+        if (auto it = dict.find("router_file"); it != dict.end()) {
+            settings.router_file = it->second.AsString();
+        }
+        return settings;
+    }
+
+    // "distance_mode": "precise" (по умолчанию) или "equirectangular"
+    geo::DistanceMode JsonReader::GetDistanceMode(const json::Dict& dict){
+        using namespace std::literals;
+        const auto it = dict.find("distance_mode"s);
+        if (it == dict.end() || it->second.AsString() == "precise"s) {
+            return geo::DistanceMode::PRECISE;
+        }
+        if (it->second.AsString() == "equirectangular"s) {
+            return geo::DistanceMode::EQUIRECTANGULAR;
+        }
+        throw std::invalid_argument("Unknown distance_mode: "s + it->second.AsString());
+    }
+
     void JsonReader::AddStop(const json::Node& node) {
         using namespace std::literals;
           domain::Stop stop;
           const auto &tmp =  node.AsMap();
           stop.name = tmp.at("name"s).AsString();
           stop.coordinates = {tmp.at("latitude"s).AsDouble(),tmp.at("longitude"s).AsDouble()};
-          transport_catalogue_.AddStop(stop);
+          transport_catalogue_->AddStop(stop);
           road_distances_.push_back({std::make_unique<Node>(tmp.at("name"s)), // @suppress("Invalid arguments")
               std::make_unique<Node>(tmp.at("road_distances"s))});
     }
@@ -151,6 +272,7 @@ namespace jsonreader
 
         ParseStopDistance();
         ParseBus();
+        transport_catalogue_->Freeze();
 
     }
 
@@ -165,9 +287,9 @@ namespace jsonreader
                     const auto& map = stop_second_node.AsMap();
                     if (map.size() != 0) {
                         for (const auto& [key, value] : map) {
-                            stop_from = transport_catalogue_.FindStop(stop_form_name.AsString());
+                            stop_from = transport_catalogue_->FindStop(stop_form_name.AsString());
                             dist =  value.IsInt() ? value.AsInt() : 0; // @suppress("Method cannot be resolved")
-                            transport_catalogue_.SetDistanceBetweenStop(key, stop_from, dist); // @suppress("Invalid arguments")
+                            transport_catalogue_->SetDistanceBetweenStop(key, stop_from, dist); // @suppress("Invalid arguments")
                         }
                     }
             }
@@ -179,7 +301,7 @@ namespace jsonreader
             const auto &bus_map = tmp.AsMap();
             bool is_roundtrip =  bus_map.at("is_roundtrip").AsBool();
             std::vector<std::string_view> route = ParseRoute(bus_map.at("stops").AsArray(),is_roundtrip);
-            transport_catalogue_.AddBus(bus_map.at("name").AsString(), route, is_roundtrip);
+            transport_catalogue_->AddBus(bus_map.at("name").AsString(), route, is_roundtrip);
         }
     }
 
@@ -224,15 +346,87 @@ namespace jsonreader
                           .Build();
     }
 
-    std::optional<transport_router::EdgeDescriptions> JsonReader::BuildOptimalRoute(std::string_view stop_from, std::string_view stop_to) const {
-        return router_.BuildRoute(stop_from, stop_to);
+    // Строит маршрутизатор по загруженному справочнику: обычный или, при shard_count > 1, шардированный
+    void JsonReader::BuildRouter(const transport_router::RoutingSettings& settings) {
+        // Предыдущее построение не должно писать в router_ одновременно с новым
+        WaitForRouter();
+        router_ready_ = std::async(std::launch::async, [this, settings] {
+            if (settings.shard_count_ > 1) {
+                sharded_router_ = std::make_unique<sharded_router::ShardedRouter>(settings, *transport_catalogue_, settings.shard_count_);
+            } else {
+                router_ = {settings, transport_catalogue_};
+            }
+        }).share();
     }
 
-    json::Node JsonReader::ProcessRouteQuery(const json::Node& elem) {
+    bool JsonReader::HasRouteRequests(const json::Dict& document) {
         using namespace std::literals;
-        const auto &tmp = elem.AsMap();
-        auto route_description =
-              BuildOptimalRoute(tmp.at("from").AsString(), tmp.at("to").AsString());
+        const auto it = document.find("stat_requests"s);
+        if (it == document.end()) {
+            return false;
+        }
+        const json::Array& requests = it->second.AsArray();
+        return std::any_of(requests.begin(), requests.end(), [](const json::Node& request) {
+            return request.AsMap().at("type"s).AsString() == "Route"sv;
+        });
+    }
+
+    void JsonReader::WaitForRouter() const {
+        if (router_ready_.valid()) {
+            // Исключение из построения маршрутизатора перебрасывается здесь
+            router_ready_.get();
+        }
+    }
+
+    // Строит маршрутизатор и сохраняет его состояние, чтобы process_requests не строил его заново
+    void JsonReader::SaveRouter(const transport_router::RoutingSettings& settings, const std::string& router_file) {
+        using namespace std::literals;
+        if (settings.shard_count_ > 1) {
+            throw serialization::SerializationError("router_file is not supported with shard_count > 1"s);
+        }
+        const transport_router::TransportRouter router(settings, transport_catalogue_);
+        std::ofstream out(router_file, std::ios::binary);
+        if (!out) {
+            throw serialization::SerializationError("Cannot open "s + router_file + " for writing"s);
+        }
+        serialization::SerializeRouterState(router, *transport_catalogue_, out);
+    }
+
+    void JsonReader::LoadRouter(const transport_router::RoutingSettings& settings, const std::string& router_file) {
+        using namespace std::literals;
+        if (settings.shard_count_ > 1) {
+            throw serialization::SerializationError("router_file is not supported with shard_count > 1"s);
+        }
+        std::ifstream in(router_file, std::ios::binary);
+        if (!in) {
+            throw serialization::SerializationError("Cannot open "s + router_file);
+        }
+        WaitForRouter();
+        auto state = serialization::DeserializeRouterState(in, *transport_catalogue_, settings);
+        // Несогласованное состояние (рёбра, вершины остановок, матрица путей) отвергает конструктор маршрутизатора
+        try {
+            router_ = {settings, transport_catalogue_, std::move(state)};
+        } catch (const std::invalid_argument& error) {
+            throw serialization::SerializationError("Router state is corrupted: "s + error.what());
+        }
+    }
+
+    std::vector<std::optional<transport_router::EdgeDescriptions>> JsonReader::BuildOptimalRoutes(
+            const std::vector<transport_router::RouteQuery>& queries) const {
+        WaitForRouter();
+        if (!sharded_router_) {
+            return router_.BuildRoutes(queries);
+        }
+        std::vector<std::optional<transport_router::EdgeDescriptions>> routes;
+        routes.reserve(queries.size());
+        for (const auto& [stop_from, stop_to] : queries) {
+            routes.push_back(sharded_router_->BuildRoute(stop_from, stop_to));
+        }
+        return routes;
+    }
+
+    json::Node JsonReader::ProcessRouteQuery(const json::Node& elem,
+                                             const std::optional<transport_router::EdgeDescriptions>& route_description) {
               if (!route_description.has_value()) {
                   return MakeErrorResponse(elem);
               } else {
@@ -243,8 +437,8 @@ namespace jsonreader
     json::Node JsonReader::ProcessStopQuery(const json::Node& elem) {
 
         const std::string& name_stop = elem.AsMap().at("name").AsString();
-         if(transport_catalogue_.StopExists(name_stop)){
-             auto stop_info = transport_catalogue_.GetStopInfo(name_stop);
+         if(transport_catalogue_->StopExists(name_stop)){
+             auto stop_info = transport_catalogue_->GetStopInfo(name_stop);
              return MakeJSONStopResponse(elem, stop_info);
          }
          else{
@@ -252,6 +446,57 @@ namespace jsonreader
          }
     }
 
+    json::Node JsonReader::MakeJSONNearbyStopsResponse(const json::Node& elem, const std::vector<domain::NearbyStop>& stops) {
+        json::Array items;
+        for (const domain::NearbyStop& nearby : stops) {
+            items.push_back(json::Builder{}.StartDict()
+                                .Key("name"s).Value(std::string{nearby.stop->name})
+                                .Key("distance"s).Value(nearby.distance)
+                                .EndDict().Build());
+        }
+        return json::Builder{}.StartDict()
+                     .Key("request_id"s).Value(elem.AsMap().at("id").AsInt())
+                     .Key("stops"s).Value(items)
+                     .EndDict().Build();
+    }
+
+    /**
+     * Запрос NearbyStops: остановки в радиусе radius метров от точки (latitude, longitude),
+     * не более limit штук (если limit задан), по возрастанию расстояния.
+     */
+    json::Node JsonReader::ProcessNearbyStopsQuery(const json::Node& elem) {
+        const auto &tmp = elem.AsMap();
+        const geo::Coordinates center{tmp.at("latitude"s).AsDouble(), tmp.at("longitude"s).AsDouble()};
+        size_t limit = std::numeric_limits<size_t>::max();
+        if (auto it = tmp.find("limit"s); it != tmp.end()) {
+            limit = it->second.AsInt() > 0 ? static_cast<size_t>(it->second.AsInt()) : 0;
+        }
+        return MakeJSONNearbyStopsResponse(elem,
+                transport_catalogue_->FindNearbyStops(center, tmp.at("radius"s).AsDouble(), limit, distance_mode_));
+    }
+
+    json::Node JsonReader::MakeJSONDirectBusesResponse(const json::Node& elem, const std::vector<const domain::Bus*>& buses) {
+        json::Array items;
+        for (const domain::Bus* bus : buses) {
+            items.push_back(std::string{bus->name});
+        }
+        return json::Builder{}.StartDict()
+                     .Key("request_id"s).Value(elem.AsMap().at("id").AsInt())
+                     .Key("buses"s).Value(items)
+                     .EndDict().Build();
+    }
+
+    // Запрос DirectBuses: маршруты, которыми можно доехать от остановки from до остановки to без пересадок
+    json::Node JsonReader::ProcessDirectBusesQuery(const json::Node& elem) {
+        const auto &tmp = elem.AsMap();
+        const domain::Stop* from = transport_catalogue_->FindStop(tmp.at("from"s).AsString());
+        const domain::Stop* to = transport_catalogue_->FindStop(tmp.at("to"s).AsString());
+        if (from == nullptr || to == nullptr) {
+            return MakeErrorResponse(elem);
+        }
+        return MakeJSONDirectBusesResponse(elem, transport_catalogue_->FindDirectBuses(from, to));
+    }
+
     json::Node JsonReader::MakeErrorResponse(const json::Node& elem) {
              return json::Builder{}.StartDict()
                            .Key("request_id"s).Value(elem.AsMap().at("id").AsInt())
@@ -273,7 +518,7 @@ namespace jsonreader
     		                                   const transport_catalogue::BusesListPointer& buses,
 											   SettingsOutput& settings){
          map_render::MapRender render(settings.render_settings);
-    	 domain::StopCoordinatesListPointer coordinates_bus = transport_catalogue_.GetCoordinatesStopBuses(*buses);
+    	 domain::StopCoordinatesListPointer coordinates_bus = transport_catalogue_->GetCoordinatesStopBuses(*buses);
     	 std::ostringstream os;
     	 render.RenderSvg(coordinates_bus, os);
 
@@ -285,7 +530,7 @@ namespace jsonreader
 
     json::Node JsonReader::ProcessBusQuery(const json::Node& elem) {
 
-        auto bus_info = transport_catalogue_.GetBusInfo(elem.AsMap().at("name").AsString());
+        auto bus_info = transport_catalogue_->GetBusInfo(elem.AsMap().at("name").AsString());
         if (bus_info.found == false) {
             return MakeErrorResponse(elem);
         }else{
@@ -296,7 +541,7 @@ namespace jsonreader
     json::Node JsonReader::ProcessMapQuery(const json::Node& elem, SettingsOutput& settings) {
 
 
-        transport_catalogue::BusesListPointer buses = transport_catalogue_.GetBuses();
+        transport_catalogue::BusesListPointer buses = transport_catalogue_->GetBuses();
         if (buses->size() != 0){
         	return	MakeJSONMapResponse(elem, buses, settings);
         }
@@ -309,6 +554,18 @@ namespace jsonreader
         using namespace std::literals;
         json::Array result;
 
+        // Маршруты считаются одной пачкой при первом запросе Route: маршрутизатор группирует запросы с общим
+        // началом или концом. Ответы до него не ждут маршрутизатор, который строится в фоне
+        std::vector<transport_router::RouteQuery> route_queries;
+        for (const auto &elem : array) {
+            const auto &request = elem.AsMap();
+            if (request.at("type").AsString() == "Route"sv) {
+                route_queries.emplace_back(request.at("from").AsString(), request.at("to").AsString());
+            }
+        }
+        std::optional<std::vector<std::optional<transport_router::EdgeDescriptions>>> routes;
+        size_t route_index = 0;
+
     	domain::BusInfo bus_info;
         for(const auto &elem : array){
             const auto &type = elem.AsMap().at("type").AsString();
@@ -322,7 +579,16 @@ namespace jsonreader
                 result.push_back(ProcessMapQuery(elem, settings_output));
             }
             else if(type == "Route"sv){
-                result.push_back(ProcessRouteQuery(elem));
+                if (!routes) {
+                    routes = BuildOptimalRoutes(route_queries);
+                }
+                result.push_back(ProcessRouteQuery(elem, (*routes)[route_index++]));
+            }
+            else if(type == "NearbyStops"sv){
+                result.push_back(ProcessNearbyStopsQuery(elem));
+            }
+            else if(type == "DirectBuses"sv){
+                result.push_back(ProcessDirectBusesQuery(elem));
             }
         }
 
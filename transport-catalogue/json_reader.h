@@ -6,11 +6,17 @@
 #include <fstream>
 #include "domain.h"
 #include <memory>
+#include <future>
+#include <algorithm>
 #include <sstream>
 #include "map_renderer.h"
 #include "json_builder.h"
 #include "transport_router.h"
+#include "sharded_router.h"
+#include "serialization.h"
 #include <optional>
+#include <limits>
+#include <stdexcept>
 
 namespace jsonreader
 {
@@ -30,6 +36,10 @@ namespace jsonreader
     public:
         JsonReader() = default;
         std::string ProcessJson(std::istream& input_json, std::ostream& out);
+        // Загружает базу и настройки из JSON и сохраняет их в файл из serialization_settings
+        void MakeBase(std::istream& input_json);
+        // Восстанавливает базу из файла serialization_settings и отвечает на stat_requests
+        void ProcessRequests(std::istream& input_json, std::ostream& out);
 
     private:
 
@@ -42,22 +52,46 @@ namespace jsonreader
         map_render::RenderSettings GetSettingsRender(const json::Dict& dict);
         svg::Color ConvertToColor(const Node&);
         transport_router::RoutingSettings GetRoutingSettings(const json::Dict& dict);
+        serialization::SerializationSettings GetSerializationSettings(const json::Dict& dict);
+        geo::DistanceMode GetDistanceMode(const json::Dict& dict);
         std::vector<NodeUniquePair> road_distances_;
         std::vector<NodeUnique> bus_;
-        transport_catalogue::TransportCatalogue transport_catalogue_;
+        // Общий с маршрутизатором: он читает справочник, не копируя его
+        std::shared_ptr<transport_catalogue::TransportCatalogue> transport_catalogue_ = std::make_shared<transport_catalogue::TransportCatalogue>();
         transport_router::TransportRouter router_;
+        std::unique_ptr<sharded_router::ShardedRouter> sharded_router_; // Вместо router_, если задан shard_count > 1
+        geo::DistanceMode distance_mode_ = geo::DistanceMode::PRECISE;  // Для NearbyStops, из search_settings
+        // Готовность router_ или sharded_router_, которые BuildRouter строит в фоне. Объявлено последним:
+        // разрушается первым и дожидается построения, пока справочник и маршрутизатор ещё живы
+        std::shared_future<void> router_ready_;
 
-        std::optional<transport_router::EdgeDescriptions> BuildOptimalRoute(std::string_view stop_from, std::string_view stop_to) const;
+        // Есть ли в stat_requests документа запросы Route: без них маршрутизатор не строится
+        static bool HasRouteRequests(const json::Dict& document);
+        // Запускает построение маршрутизатора в фоне; справочник после этого не меняется
+        void BuildRouter(const transport_router::RoutingSettings& settings);
+        // Ждёт фонового построения: до него router_ и sharded_router_ читать нельзя
+        void WaitForRouter() const;
+        void SaveRouter(const transport_router::RoutingSettings& settings, const std::string& router_file);
+        // Маршрутизатор из файла SaveRouter вместо построения; файл должен соответствовать справочнику и настройкам
+        void LoadRouter(const transport_router::RoutingSettings& settings, const std::string& router_file);
+
+        // Ответы на запросы Route в том же порядке
+        std::vector<std::optional<transport_router::EdgeDescriptions>> BuildOptimalRoutes(
+                const std::vector<transport_router::RouteQuery>& queries) const;
 
         json::Node MakeJSONRouteResponse(const transport_router::EdgeDescriptions& route_description,
                                          const json::Node& elem);
         json::Node ProcessStopQuery(const json::Node& elem);
         json::Node ProcessBusQuery(const json::Node& elem);
-        json::Node ProcessRouteQuery(const json::Node& elem);
+        json::Node ProcessRouteQuery(const json::Node& elem, const std::optional<transport_router::EdgeDescriptions>& route_description);
         json::Node ProcessMapQuery(const json::Node& elem, SettingsOutput& settings);
+        json::Node ProcessNearbyStopsQuery(const json::Node& elem);
+        json::Node ProcessDirectBusesQuery(const json::Node& elem);
         json::Node MakeErrorResponse(const json::Node& elem);
         json::Node MakeJSONBusResponse(const json::Node& elem,  const domain::BusInfo& bus_info);
         json::Node MakeJSONStopResponse(const json::Node& elem, const std::set<std::string> stop_info);
+        json::Node MakeJSONNearbyStopsResponse(const json::Node& elem, const std::vector<domain::NearbyStop>& stops);
+        json::Node MakeJSONDirectBusesResponse(const json::Node& elem, const std::vector<const domain::Bus*>& buses);
         json::Node MakeJSONMapResponse(const json::Node& elem,
            		                                   const transport_catalogue::BusesListPointer& buses,
        											   SettingsOutput& settings);
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lru_cache {
+
+    struct CacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    /**
+     * LRU-кэш с ограничением по занятой памяти, разбитый на независимые шарды.
+     * Ключ попадает в шард по хешу, у каждого шарда свой мьютекс, свой список LRU
+     * и своя доля ёмкости, поэтому потоки с разными ключами почти не мешают друг другу.
+     *
+     * Размер записи — SizeOf{}(value) плюс оценка служебных расходов списка и хеш-таблицы.
+     * Запись больше доли шарда в кэш не попадает.
+     */
+    template <typename Key, typename Value, typename Hasher, typename SizeOf>
+    class ShardedLruCache {
+    public:
+        static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+        explicit ShardedLruCache(size_t capacity_bytes, size_t shard_count = DEFAULT_SHARD_COUNT);
+
+        // Копия значения, если ключ есть в кэше; запись становится самой свежей в своём шарде
+        std::optional<Value> Get(const Key& key);
+        void Put(const Key& key, Value value);
+        void Clear();
+
+        size_t GetCapacity() const;
+        CacheStats GetStats() const;
+
+    private:
+        struct Entry {
+            Key key;
+            Value value;
+            size_t bytes;
+        };
+
+        using EntryList = std::list<Entry>;
+
+        struct Shard {
+            mutable std::mutex mutex;
+            EntryList entries; // В начале — самые свежие
+            std::unordered_map<Key, typename EntryList::iterator, Hasher> index;
+            size_t bytes = 0;
+            uint64_t evictions = 0;
+        };
+
+        // Узел списка, узел хеш-таблицы и её корзина
+        static constexpr size_t ENTRY_OVERHEAD = sizeof(Entry) + 2 * sizeof(void*)
+                + sizeof(std::pair<const Key, typename EntryList::iterator>) + 3 * sizeof(void*);
+
+        Shard& GetShard(const Key& key);
+
+        size_t capacity_;
+        size_t shard_capacity_;
+        std::vector<Shard> shards_;
+        std::atomic<uint64_t> hits_ = 0;
+        std::atomic<uint64_t> misses_ = 0;
+    };
+
+    template <typename Key, typename Value, typename Hasher, typename SizeOf>
+    ShardedLruCache<Key, Value, Hasher, SizeOf>::ShardedLruCache(size_t capacity_bytes, size_t shard_count)
+            : capacity_(capacity_bytes),
+              shard_capacity_(capacity_bytes / (shard_count == 0 ? 1 : shard_count)),
+              shards_(shard_count == 0 ? 1 : shard_count) {
+    }
+
+    template <typename Key, typename Value, typename Hasher, typename SizeOf>
+    typename ShardedLruCache<Key, Value, Hasher, SizeOf>::Shard& ShardedLruCache<Key, Value, Hasher, SizeOf>::GetShard(const Key& key) {
+        // Старшие биты перемешиваем с младшими, чтобы выбор шарда не повторял выбор корзины внутри шарда
+        const size_t hash = Hasher{}(key);
+        return shards_[(hash ^ (hash >> 29)) % shards_.size()];
+    }
+
+    template <typename Key, typename Value, typename Hasher, typename SizeOf>
+    std::optional<Value> ShardedLruCache<Key, Value, Hasher, SizeOf>::Get(const Key& key) {
+        Shard& shard = GetShard(key);
+        std::lock_guard lock(shard.mutex);
+        const auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return it->second->value;
+    }
+
+    template <typename Key, typename Value, typename Hasher, typename SizeOf>
+    void ShardedLruCache<Key, Value, Hasher, SizeOf>::Put(const Key& key, Value value) {
+        const size_t bytes = SizeOf{}(value) + ENTRY_OVERHEAD;
+        if (bytes > shard_capacity_) {
+            return;
+        }
+        Shard& shard = GetShard(key);
+        std::lock_guard lock(shard.mutex);
+        if (const auto it = shard.index.find(key); it != shard.index.end()) {
+            shard.bytes -= it->second->bytes;
+            shard.entries.erase(it->second);
+            shard.index.erase(it);
+        }
+        while (shard.bytes + bytes > shard_capacity_) {
+            const Entry& oldest = shard.entries.back();
+            shard.bytes -= oldest.bytes;
+            shard.index.erase(oldest.key);
+            shard.entries.pop_back();
+            ++shard.evictions;
+        }
+        shard.entries.push_front({key, std::move(value), bytes});
+        shard.index.emplace(key, shard.entries.begin());
+        shard.bytes += bytes;
+    }
+
+    template <typename Key, typename Value, typename Hasher, typename SizeOf>
+    void ShardedLruCache<Key, Value, Hasher, SizeOf>::Clear() {
+        for (Shard& shard : shards_) {
+            std::lock_guard lock(shard.mutex);
+            shard.entries.clear();
+            shard.index.clear();
+            shard.bytes = 0;
+        }
+    }
+
+    template <typename Key, typename Value, typename Hasher, typename SizeOf>
+    size_t ShardedLruCache<Key, Value, Hasher, SizeOf>::GetCapacity() const {
+        return capacity_;
+    }
+
+    template <typename Key, typename Value, typename Hasher, typename SizeOf>
+    CacheStats ShardedLruCache<Key, Value, Hasher, SizeOf>::GetStats() const {
+        CacheStats stats;
+        stats.hits = hits_.load(std::memory_order_relaxed);
+        stats.misses = misses_.load(std::memory_order_relaxed);
+        for (const Shard& shard : shards_) {
+            std::lock_guard lock(shard.mutex);
+            stats.evictions += shard.evictions;
+            stats.entries += shard.entries.size();
+            stats.bytes += shard.bytes;
+        }
+        return stats;
+    }
+
+}
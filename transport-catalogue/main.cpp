@@ -1,13 +1,36 @@
 #include <iostream>
+#include <string_view>
 #include "json_reader.h"
 
 using namespace std;
 
-int main() {
+void PrintUsage(std::ostream& stream = std::cerr) {
+    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+}
+
+int main(int argc, char* argv[]) {
 
     jsonreader::JsonReader jr;
-    jr.ProcessJson(std::cin, std::cout);
 
-}
+    // Без аргументов база и запросы читаются из одного JSON, как раньше
+    if (argc == 1) {
+        jr.ProcessJson(std::cin, std::cout);
+        return 0;
+    }
+    if (argc != 2) {
+        PrintUsage();
+        return 1;
+    }
 
+    const std::string_view mode(argv[1]);
 
+    if (mode == "make_base"sv) {
+        jr.MakeBase(std::cin);
+    } else if (mode == "process_requests"sv) {
+        jr.ProcessRequests(std::cin, std::cout);
+    } else {
+        PrintUsage();
+        return 1;
+    }
+
+}
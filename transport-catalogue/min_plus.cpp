@@ -0,0 +1,65 @@
+#include "min_plus.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MIN_PLUS_HAS_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+namespace min_plus {
+
+    namespace {
+#ifdef MIN_PLUS_HAS_AVX2_KERNEL
+        // Собирается с AVX2 независимо от флагов сборки. Возвращает число обработанных элементов, кратное четырём
+        __attribute__((target("avx2")))
+        size_t RelaxRowAvx2(double through, const double* row_weights, const uint32_t* row_edges,
+                            double* weights, uint32_t* edges, size_t size) {
+            const __m256d through_vector = _mm256_set1_pd(through);
+            // Младшие половины 64-битных масок сравнения — маска для четырёх 32-битных рёбер
+            const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                const __m256d candidate = _mm256_add_pd(through_vector, _mm256_loadu_pd(row_weights + i));
+                const __m256d current = _mm256_loadu_pd(weights + i);
+                const __m256d less = _mm256_cmp_pd(candidate, current, _CMP_LT_OQ);
+                if (_mm256_movemask_pd(less) == 0) {
+                    continue;
+                }
+                _mm256_storeu_pd(weights + i, _mm256_blendv_pd(current, candidate, less));
+                const __m128i edge_mask = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(less), low_halves));
+                const __m128i current_edges = _mm_loadu_si128(reinterpret_cast<const __m128i*>(edges + i));
+                const __m128i new_edges = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_edges + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(edges + i), _mm_blendv_epi8(current_edges, new_edges, edge_mask));
+            }
+            return i;
+        }
+
+        bool CpuSupportsAvx2() {
+            static const bool supported = __builtin_cpu_supports("avx2");
+            return supported;
+        }
+#endif
+    }
+
+    void RelaxRowScalar(double through, const double* row_weights, const uint32_t* row_edges,
+                        double* weights, uint32_t* edges, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            const double candidate = through + row_weights[i];
+            if (candidate < weights[i]) {
+                weights[i] = candidate;
+                edges[i] = row_edges[i];
+            }
+        }
+    }
+
+    void RelaxRow(double through, const double* row_weights, const uint32_t* row_edges,
+                  double* weights, uint32_t* edges, size_t size) {
+        size_t i = 0;
+#ifdef MIN_PLUS_HAS_AVX2_KERNEL
+        if (CpuSupportsAvx2()) {
+            i = RelaxRowAvx2(through, row_weights, row_edges, weights, edges, size);
+        }
+#endif
+        RelaxRowScalar(through, row_weights + i, row_edges + i, weights + i, edges + i, size - i);
+    }
+
+}
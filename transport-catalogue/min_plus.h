@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace min_plus {
+
+    /**
+     * Релаксация строки матрицы через одну промежуточную вершину: для каждого i из [0, size),
+     * если through + row_weights[i] < weights[i], то weights[i] = through + row_weights[i], edges[i] = row_edges[i].
+     * На x86 векторный вариант собирается всегда, а выбирается при запуске: с AVX2 — по четыре элемента за раз.
+     * Сравнение и сложение те же, что в скалярном варианте, поэтому результат совпадает до бита.
+     */
+    void RelaxRow(double through, const double* row_weights, const uint32_t* row_edges,
+                  double* weights, uint32_t* edges, size_t size);
+
+    // Скалярный вариант, используется для хвостов и для проверки векторного
+    void RelaxRowScalar(double through, const double* row_weights, const uint32_t* row_edges,
+                        double* weights, uint32_t* edges, size_t size);
+
+}
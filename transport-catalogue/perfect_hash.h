@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace perfect_hash {
+
+    /**
+     * Минимальная совершенная хеш-функция над неизменяемым набором строк (схема hash-and-displace, как в CHD).
+     * Ключи раскладываются по корзинам, для каждой корзины подбирается смещение, при котором все её ключи
+     * попадают в свободные ячейки таблицы размера ровно n. Корзины из одного ключа кладутся
+     * прямо в оставшиеся свободные ячейки без перебора.
+     *
+     * Поиск: один хеш строки, одно чтение смещения, одно чтение ячейки и сравнение ключа.
+     * Ключ, которого не было при построении, тоже попадёт в какую-то ячейку, поэтому сравнение обязательно.
+     */
+    template <typename Value>
+    class PerfectHashMap {
+    public:
+        PerfectHashMap() = default;
+
+        // Ключи должны быть уникальными и жить дольше таблицы.
+        // Возвращает false (и оставляет таблицу пустой), если разместить ключи не удалось,
+        // например, из-за полного совпадения их хешей.
+        bool Build(const std::vector<std::pair<std::string_view, Value>>& items) {
+            entries_.clear();
+            displacements_.clear();
+            const size_t size = items.size();
+            if (size == 0) {
+                return true;
+            }
+
+            std::vector<uint64_t> hashes(size);
+            for (size_t i = 0; i < size; ++i) {
+                hashes[i] = std::hash<std::string_view>{}(items[i].first);
+            }
+
+            const size_t bucket_count = (size + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET;
+            std::vector<std::vector<uint32_t>> buckets(bucket_count);
+            for (size_t i = 0; i < size; ++i) {
+                buckets[Reduce(Mix(hashes[i]), bucket_count)].push_back(static_cast<uint32_t>(i));
+            }
+            // Сначала размещаем самые большие корзины, пока в таблице много свободного места
+            std::vector<uint32_t> order(bucket_count);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t lhs, uint32_t rhs) {
+                return buckets[lhs].size() > buckets[rhs].size();
+            });
+
+            displacements_.assign(bucket_count, 0);
+            std::vector<bool> taken(size, false);
+            std::vector<size_t> slots;
+            size_t order_pos = 0;
+            for (; order_pos < bucket_count && buckets[order[order_pos]].size() > 1; ++order_pos) {
+                const auto& bucket = buckets[order[order_pos]];
+                for (uint32_t seed = 0;; ++seed) {
+                    if (seed == MAX_SEED) {
+                        displacements_.clear();
+                        return false;
+                    }
+                    slots.clear();
+                    bool fits = true;
+                    for (uint32_t key : bucket) {
+                        const size_t slot = Slot(hashes[key], seed, size);
+                        if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                            fits = false;
+                            break;
+                        }
+                        slots.push_back(slot);
+                    }
+                    if (fits) {
+                        for (size_t slot : slots) {
+                            taken[slot] = true;
+                        }
+                        displacements_[order[order_pos]] = static_cast<int32_t>(seed);
+                        break;
+                    }
+                }
+            }
+
+            // Одиночные корзины: отрицательное смещение кодирует номер ячейки напрямую
+            size_t free_slot = 0;
+            for (; order_pos < bucket_count && buckets[order[order_pos]].size() == 1; ++order_pos) {
+                while (taken[free_slot]) {
+                    ++free_slot;
+                }
+                taken[free_slot] = true;
+                displacements_[order[order_pos]] = -static_cast<int32_t>(free_slot) - 1;
+            }
+
+            entries_.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                entries_[SlotOf(hashes[i])] = items[i];
+            }
+            return true;
+        }
+
+        // Значение по ключу или nullptr, если ключа нет
+        const Value* Find(std::string_view key) const {
+            if (entries_.empty()) {
+                return nullptr;
+            }
+            const auto& entry = entries_[SlotOf(std::hash<std::string_view>{}(key))];
+            return entry.first == key ? &entry.second : nullptr;
+        }
+
+        size_t Size() const {
+            return entries_.size();
+        }
+
+    private:
+        static constexpr size_t KEYS_PER_BUCKET = 4;
+        static constexpr uint32_t MAX_SEED = 1u << 20;
+
+        static uint64_t Mix(uint64_t value) {
+            // Финализатор splitmix64
+            value ^= value >> 30;
+            value *= 0xbf58476d1ce4e5b9ULL;
+            value ^= value >> 27;
+            value *= 0x94d049bb133111ebULL;
+            return value ^ (value >> 31);
+        }
+
+        // Отображение 64-битного хеша в [0, size) умножением вместо деления
+        static size_t Reduce(uint64_t hash, size_t size) {
+            return static_cast<size_t>((static_cast<unsigned __int128>(hash) * size) >> 64);
+        }
+
+        static size_t Slot(uint64_t hash, uint32_t seed, size_t size) {
+            return Reduce(Mix(hash + 0x9e3779b97f4a7c15ULL * (seed + 1)), size);
+        }
+
+        size_t SlotOf(uint64_t hash) const {
+            const int32_t displacement = displacements_[Reduce(Mix(hash), displacements_.size())];
+            return displacement < 0 ? static_cast<size_t>(-(displacement + 1))
+                                    : Slot(hash, static_cast<uint32_t>(displacement), entries_.size());
+        }
+
+        std::vector<int32_t> displacements_;
+        std::vector<std::pair<std::string_view, Value>> entries_; // Ключ хранится для проверочного сравнения
+    };
+
+}
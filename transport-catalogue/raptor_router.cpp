@@ -0,0 +1,174 @@
+#include "raptor_router.h"
+
+#include <algorithm>
+
+namespace raptor {
+
+    RaptorRouter::RaptorRouter(const transport_catalogue::TransportCatalogue& catalogue,
+                               const transport_router::RoutingSettings& settings)
+            : bus_wait_time_(settings.bus_wait_time_),
+              minutes_per_meter_(transport_router::MIN_PER_HOUR / transport_router::METERS_PER_KM / settings.bus_velocity_) {
+        const size_t stop_count = catalogue.GetStopCount();
+        stop_names_.resize(stop_count);
+        for (const domain::Stop& stop : catalogue.GetAllStops()) {
+            stop_names_[stop.id] = stop.name;
+        }
+
+        std::vector<uint32_t> degrees(stop_count, 0);
+        for (const domain::Bus& bus : catalogue.GetAllBuses()) {
+            const domain::RouteView route(bus);
+            if (route.size() < 2) {
+                continue;
+            }
+            routes_.push_back({bus.name, static_cast<uint32_t>(route_stops_.size()), static_cast<uint32_t>(route.size())});
+            for (size_t position = 0; position < route.size(); ++position) {
+                route_stops_.push_back(static_cast<uint32_t>(route[position]->id));
+                route_distances_.push_back(catalogue.GetRoadDistanceOnBus(bus, 0, position));
+                ++degrees[route[position]->id];
+            }
+        }
+
+        // Позиции маршрутов по остановкам: сначала степени, затем раскладка по местам
+        stop_route_offsets_.assign(stop_count + 1, 0);
+        for (size_t stop = 0; stop < stop_count; ++stop) {
+            stop_route_offsets_[stop + 1] = stop_route_offsets_[stop] + degrees[stop];
+        }
+        stop_positions_.resize(route_stops_.size());
+        std::copy(stop_route_offsets_.begin(), stop_route_offsets_.end() - 1, degrees.begin());
+        for (uint32_t route = 0; route < routes_.size(); ++route) {
+            for (uint32_t position = 0; position < routes_[route].size; ++position) {
+                const uint32_t stop = route_stops_[routes_[route].first + position];
+                stop_positions_[degrees[stop]++] = {route, position};
+            }
+        }
+    }
+
+    double RaptorRouter::RideTime(const Route& route, uint32_t board, uint32_t alight) const {
+        // Так же, как вес ребра-поездки в графе TransportRouter: целое расстояние, умноженное на минуты на метр
+        return (route_distances_[route.first + alight] - route_distances_[route.first + board]) * minutes_per_meter_;
+    }
+
+    RaptorRouter::Rounds RaptorRouter::Search(size_t from, size_t to) const {
+        const size_t stop_count = stop_names_.size();
+        Rounds rounds(1, std::vector<Label>(stop_count));
+        rounds[0][from].time = 0.0;
+        // Лучшее прибытие по всем раундам: улучшение засчитывается, только если оно строго быстрее
+        std::vector<double> best(stop_count, std::numeric_limits<double>::infinity());
+        best[from] = 0.0;
+
+        std::vector<size_t> marked{from};
+        std::vector<bool> is_marked(stop_count, false);
+        // По маршруту: самая ранняя позиция, с которой его нужно просмотреть в текущем раунде
+        std::vector<uint32_t> route_start(routes_.size(), NO_POSITION);
+        std::vector<uint32_t> queue;
+        uint64_t scanned = 0;
+
+        while (!marked.empty()) {
+            for (const size_t stop : marked) {
+                is_marked[stop] = false;
+                for (uint32_t i = stop_route_offsets_[stop]; i < stop_route_offsets_[stop + 1]; ++i) {
+                    const auto [route, position] = stop_positions_[i];
+                    if (route_start[route] == NO_POSITION) {
+                        queue.push_back(route);
+                    }
+                    route_start[route] = std::min(route_start[route], position);
+                }
+            }
+            marked.clear();
+
+            const std::vector<Label>& previous = rounds.back();
+            std::vector<Label> current(stop_count);
+            for (const uint32_t route_index : queue) {
+                const Route& route = routes_[route_index];
+                bool on_board = false;
+                double boarded_time = 0.0; // Время у вагона в позиции посадки, ожидание уже учтено
+                uint32_t board = 0;
+                for (uint32_t position = route_start[route_index]; position < route.size; ++position) {
+                    const uint32_t stop = route_stops_[route.first + position];
+                    double arrival = std::numeric_limits<double>::infinity();
+                    if (on_board) {
+                        arrival = boarded_time + RideTime(route, board, position);
+                        if (arrival < best[stop] && arrival < best[to]) {
+                            current[stop] = {arrival, route_index, board, position};
+                            best[stop] = arrival;
+                            if (!is_marked[stop]) {
+                                is_marked[stop] = true;
+                                marked.push_back(stop);
+                            }
+                        }
+                    }
+                    // Пересесть здесь выгоднее, если с прошлого раунда сюда приехали раньше, чем доедет текущий вагон
+                    const double boarding = previous[stop].time + bus_wait_time_;
+                    if (boarding < arrival) {
+                        on_board = true;
+                        boarded_time = boarding;
+                        board = position;
+                    }
+                }
+                scanned += route.size - route_start[route_index];
+                route_start[route_index] = NO_POSITION;
+            }
+            queue.clear();
+            rounds.push_back(std::move(current));
+        }
+        scanned_positions_.fetch_add(scanned, std::memory_order_relaxed);
+        return rounds;
+    }
+
+    transport_router::EdgeDescriptions RaptorRouter::Unwind(const Rounds& rounds, size_t round, size_t to) const {
+        transport_router::EdgeDescriptions items;
+        size_t stop = to;
+        for (; round > 0; --round) {
+            const Label& label = rounds[round][stop];
+            const Route& route = routes_[label.route];
+            items.push_back({transport_router::EdgeType::BUS, route.name, RideTime(route, label.board, label.alight),
+                             static_cast<int>(label.alight - label.board)});
+            stop = route_stops_[route.first + label.board];
+            items.push_back({transport_router::EdgeType::WAIT, stop_names_[stop], bus_wait_time_, std::nullopt});
+        }
+        std::reverse(items.begin(), items.end());
+        return items;
+    }
+
+    std::optional<transport_router::EdgeDescriptions> RaptorRouter::BuildRoute(const domain::Stop* from,
+                                                                              const domain::Stop* to) const {
+        if (from == to) {
+            return transport_router::EdgeDescriptions{};
+        }
+        const Rounds rounds = Search(from->id, to->id);
+        // Каждое следующее улучшение быстрее предыдущего, нужен последний раунд с прибытием в to
+        for (size_t round = rounds.size() - 1; round > 0; --round) {
+            if (rounds[round][to->id].route != NO_POSITION) {
+                return Unwind(rounds, round, to->id);
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::vector<transport_router::EdgeDescriptions> RaptorRouter::BuildParetoRoutes(const domain::Stop* from,
+                                                                                   const domain::Stop* to) const {
+        std::vector<transport_router::EdgeDescriptions> routes;
+        if (from == to) {
+            routes.emplace_back();
+            return routes;
+        }
+        const Rounds rounds = Search(from->id, to->id);
+        for (size_t round = 1; round < rounds.size(); ++round) {
+            if (rounds[round][to->id].route != NO_POSITION) {
+                routes.push_back(Unwind(rounds, round, to->id));
+            }
+        }
+        return routes;
+    }
+
+    size_t RaptorRouter::GetMemoryUsage() const {
+        return stop_names_.capacity() * sizeof(std::string_view) + routes_.capacity() * sizeof(Route)
+                + (route_stops_.capacity() + route_distances_.capacity() + stop_route_offsets_.capacity()) * sizeof(uint32_t)
+                + stop_positions_.capacity() * sizeof(std::pair<uint32_t, uint32_t>);
+    }
+
+    uint64_t RaptorRouter::GetScannedPositionCount() const {
+        return scanned_positions_.load(std::memory_order_relaxed);
+    }
+
+}
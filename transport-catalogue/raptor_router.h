@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+namespace raptor {
+
+    /**
+     * RAPTOR (Round-bAsed Public Transit Optimized Router) прямо по маршрутам и остановкам справочника, без графа.
+     * Раунд k находит самые быстрые прибытия ровно с k поездками: просматриваются только маршруты через
+     * остановки, улучшенные в раунде k - 1, каждый — один раз, от самой ранней такой остановки до конца.
+     * Частотная модель та же, что у графа TransportRouter: на каждую посадку — bus_wait_time,
+     * поездка от позиции q до позиции p — дорожное расстояние между ними, делённое на bus_velocity.
+     *
+     * Остановки маршрутов и накопленные расстояния лежат подряд в плоских массивах, поэтому просмотр маршрута —
+     * последовательный проход по памяти. Маршруты одного раунда друг от друга не зависят: просмотры можно
+     * разнести по потокам, а запросы независимы и сейчас — BuildRoute можно вызывать из нескольких потоков.
+     * Справочник должен жить дольше маршрутизатора: имена в ответах ссылаются на него.
+     */
+    class RaptorRouter {
+    public:
+        RaptorRouter(const transport_catalogue::TransportCatalogue& catalogue, const transport_router::RoutingSettings& settings);
+
+        // Самый быстрый маршрут, при равном времени — с меньшим числом поездок; std::nullopt, если его нет
+        std::optional<transport_router::EdgeDescriptions> BuildRoute(const domain::Stop* from, const domain::Stop* to) const;
+        /**
+         * Парето-множество по времени и числу поездок: самый быстрый маршрут с одной поездкой, затем
+         * самый быстрый с двумя, если он быстрее, и так далее. Последний элемент совпадает с BuildRoute.
+         */
+        std::vector<transport_router::EdgeDescriptions> BuildParetoRoutes(const domain::Stop* from, const domain::Stop* to) const;
+
+        size_t GetMemoryUsage() const;
+        // Сколько позиций маршрутов просмотрели все запросы с момента создания
+        uint64_t GetScannedPositionCount() const;
+
+    private:
+        static constexpr uint32_t NO_POSITION = std::numeric_limits<uint32_t>::max();
+
+        struct Route {
+            std::string_view name;
+            uint32_t first = 0; // Начало маршрута в route_stops_ и route_distances_
+            uint32_t size = 0;
+        };
+
+        // Прибытие на остановку в раунде: время и поездка, которой на неё приехали
+        struct Label {
+            double time = std::numeric_limits<double>::infinity();
+            uint32_t route = NO_POSITION;
+            uint32_t board = 0;  // Позиции посадки и выхода на маршруте
+            uint32_t alight = 0;
+        };
+
+        using Rounds = std::vector<std::vector<Label>>;
+
+        // Раунды поиска: rounds[k][stop] — прибытие ровно с k поездками, если оно улучшило лучшее известное
+        Rounds Search(size_t from, size_t to) const;
+        transport_router::EdgeDescriptions Unwind(const Rounds& rounds, size_t round, size_t to) const;
+        double RideTime(const Route& route, uint32_t board, uint32_t alight) const;
+
+        double bus_wait_time_;
+        double minutes_per_meter_;
+        std::vector<std::string_view> stop_names_;   // По id остановки
+        std::vector<Route> routes_;
+        std::vector<uint32_t> route_stops_;          // По позиции полного маршрута: id остановки
+        std::vector<uint32_t> route_distances_;      // По позиции: дорожное расстояние от начала маршрута
+        std::vector<uint32_t> stop_route_offsets_;   // По id остановки: начало её позиций в stop_positions_
+        std::vector<std::pair<uint32_t, uint32_t>> stop_positions_; // (маршрут, позиция), проходящие через остановку
+        mutable std::atomic<uint64_t> scanned_positions_ = 0;
+    };
+
+}
@@ -1,124 +1,476 @@
 #pragma once
 
 #include "graph.h"
+#include "min_plus.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <limits>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace graph {
 
+    // Общий интерфейс алгоритмов поиска кратчайшего пути по DirectedWeightedGraph
     template <typename Weight>
-    class Router {
+    class RouterBase {
+    public:
+        struct RouteInfo {
+            Weight weight;
+            std::vector<EdgeId> edges;
+        };
+
+        virtual ~RouterBase() = default;
+
+        virtual std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const = 0;
+        // Примерный объём памяти, занятой самим алгоритмом, без графа
+        virtual size_t GetMemoryUsage() const = 0;
+        // Сколько вершин извлекли из куч все запросы с момента создания; 0 у алгоритмов без поиска по запросу
+        virtual uint64_t GetSettledVertexCount() const {
+            return 0;
+        }
+    };
+
+    /**
+     * Флойд–Уоршелл: все пары путей считаются в конструкторе, O(V^3) времени и O(V^2) памяти.
+     * Считается он в Workspace: веса (бесконечность у недостижимых пар) и последние рёбра путей — две плоские
+     * матрицы V x V по строкам. Матрица обходится блоками BLOCK_SIZE x BLOCK_SIZE: для очередной полосы
+     * промежуточных вершин сначала считается диагональный блок, затем блоки её строки и столбца,
+     * затем все остальные; блоки второй и третьей фаз друг от друга не зависят и считаются в потоках.
+     * Строки и столбцы промежуточных вершин запоминаются в том виде, какой был у них на своём шаге,
+     * поэтому каждая пара релаксируется теми же слагаемыми и в том же порядке, что в простом тройном
+     * цикле: веса и выбор среди равных по весу путей от блоков не зависят. Строка блока релаксируется
+     * min_plus::RelaxRow: на процессорах с AVX2 — по четыре вершины за раз при любых флагах сборки.
+     *
+     * После построения хранится только матрица последних рёбер: 16-битных, если рёбер в графе меньше 65535,
+     * иначе 32-битных. Путь из from восстанавливается по одной строке матрицы, его вес — суммой весов
+     * рёбер от начала пути, как у Дейкстры.
+     */
+    template <typename Weight>
+    class Router : public RouterBase<Weight> {
     private:
         using Graph = DirectedWeightedGraph<Weight>;
 
+    private:
+        using WideEdgeId = uint32_t; // Больше рёбер в DirectedWeightedGraph не бывает
+
     public:
-        struct RouteInternalData {
-            Weight weight;
-            std::optional<EdgeId> prev_edge;
-        };
-        using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+        // Последние рёбра кратчайших путей по строкам, [from * V + to]; NO_ROUTE_EDGE у пустого пути и у недостижимой пары
+        using RoutesInternalData = std::vector<WideEdgeId>;
+        using typename RouterBase<Weight>::RouteInfo;
+
+        static constexpr WideEdgeId NO_ROUTE_EDGE = std::numeric_limits<WideEdgeId>::max();
 
-        explicit Router(const Graph& graph);
+        // thread_count — число потоков построения, 0 — по числу ядер
+        explicit Router(const Graph& graph, size_t thread_count = 0);
+        // Готовая матрица, например из GetRoutesInternalData сохранённого маршрутизатора по тому же графу
         Router(const Graph& graph, RoutesInternalData&& routes_internal_data);
 
-        struct RouteInfo {
-            Weight weight;
-            std::vector<EdgeId> edges;
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+        size_t GetMemoryUsage() const override;
+        RoutesInternalData GetRoutesInternalData() const;
+
+    private:
+        static_assert(std::numeric_limits<Weight>::has_infinity, "Unreachable pairs are stored as infinite weight");
+
+        using NarrowEdgeId = uint16_t;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::infinity();
+        static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+        // Нет последнего ребра: путь пустой (from == to) или его нет
+        static constexpr NarrowEdgeId NO_NARROW_EDGE = std::numeric_limits<NarrowEdgeId>::max();
+        static constexpr WideEdgeId NO_WIDE_EDGE = NO_ROUTE_EDGE;
+        // 64 x 64 весов double — 32 КБ, блок строки, столбца и обновляемый помещаются в L2
+        static constexpr size_t BLOCK_SIZE = 64;
+
+        struct Span {
+            size_t begin;
+            size_t end;
+
+            bool Contains(size_t index) const {
+                return begin <= index && index < end;
+            }
         };
 
-        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+        // Матрицы построения и снимки строк и столбцов промежуточных вершин полосы на момент шага через каждую
+        struct Workspace {
+            std::vector<Weight> weights;        // [from * vertex_count_ + to]
+            std::vector<WideEdgeId> prev_edges; // [from * vertex_count_ + to], NO_WIDE_EDGE у пустого пути и у недостижимой пары
+            std::vector<Weight> row_weights;    // [(k - through.begin) * vertex_count_ + to]
+            std::vector<WideEdgeId> row_edges;  // [(k - through.begin) * vertex_count_ + to]
+            std::vector<Weight> column_weights; // [from * BLOCK_SIZE + (k - through.begin)]
+        };
 
-    private:
+        void InitializeRoutesInternalData(const Graph& graph, Workspace& workspace) const;
+        // Проверка готовой матрицы: путь к себе пустой, последнее ребро пути в to заканчивается в to,
+        // а цепочка последних рёбер без циклов приходит в from. Иначе BuildRoute мог бы не завершиться
+        void ValidateRoutesInternalData(const Graph& graph, const RoutesInternalData& routes_internal_data) const;
+        Span GetBlock(size_t block) const;
+        // Релаксация блока rows x columns через промежуточные вершины through по порядку
+        void RelaxBlock(Span rows, Span columns, Span through, Workspace& workspace) const;
+
+        /**
+         * Потоки на всё построение: создаются один раз, каждая фаза раздаёт им задачи через общий счётчик,
+         * вызывающий поток работает вместе с ними. Без потоков (thread_count <= 1) задачи выполняются по порядку.
+         */
+        class WorkerPool {
+        public:
+            explicit WorkerPool(size_t thread_count);
+            WorkerPool(const WorkerPool&) = delete;
+            WorkerPool& operator=(const WorkerPool&) = delete;
+            ~WorkerPool();
+
+            // Вызывает task(i) для каждого i из [0, count) и ждёт завершения всех
+            void Run(size_t count, const std::function<void(size_t)>& task);
 
-        void InitializeRoutesInternalData(const Graph& graph) {
-            const size_t vertex_count = graph.GetVertexCount();
-            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-                routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
-                for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                    const auto& edge = graph.GetEdge(edge_id);
-                    if (edge.weight < ZERO_WEIGHT) {
-                        throw std::domain_error("Edges' weights should be non-negative");
+        private:
+            void Work();
+            void Drain(const std::function<void(size_t)>& task, size_t count);
+
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            std::condition_variable done_;
+            const std::function<void(size_t)>* task_ = nullptr;
+            size_t count_ = 0;
+            std::atomic<size_t> next_ = 0;
+            size_t active_ = 0;      // Потоки, ещё не закончившие текущую фазу
+            uint64_t generation_ = 0; // Номер фазы: по его смене потоки просыпаются
+            bool stop_ = false;
+            std::vector<std::thread> threads_;
+        };
+        void StorePrevEdges(const std::vector<WideEdgeId>& prev_edges);
+        EdgeId GetPrevEdge(size_t index) const;
+
+        const Graph& graph_;
+        size_t vertex_count_;
+        // [from * vertex_count_ + to]: последнее ребро кратчайшего пути, заполнена одна из двух
+        std::vector<NarrowEdgeId> narrow_prev_edges_;
+        std::vector<WideEdgeId> wide_prev_edges_;
+    };
+
+    template <typename Weight>
+    Router<Weight>::Router(const Graph& graph, size_t thread_count)
+            : graph_(graph)
+            , vertex_count_(graph.GetVertexCount())
+    {
+        Workspace workspace{std::vector<Weight>(vertex_count_ * vertex_count_, UNREACHABLE),
+                            std::vector<WideEdgeId>(vertex_count_ * vertex_count_, NO_WIDE_EDGE),
+                            std::vector<Weight>(BLOCK_SIZE * vertex_count_), std::vector<WideEdgeId>(BLOCK_SIZE * vertex_count_),
+                            std::vector<Weight>(vertex_count_ * BLOCK_SIZE)};
+        InitializeRoutesInternalData(graph, workspace);
+
+        const size_t block_count = (vertex_count_ + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (thread_count == 0) {
+            thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        // При одном блоке считать параллельно нечего: потоки не создаются
+        WorkerPool pool(std::min(thread_count, block_count));
+        for (size_t through = 0; through < block_count; ++through) {
+            const Span pivot = GetBlock(through);
+            RelaxBlock(pivot, pivot, pivot, workspace);
+            // Блоки строки и столбца полосы: задачи [0, block_count) — строка, [block_count, 2 * block_count) — столбец
+            pool.Run(2 * block_count, [&](size_t task) {
+                const size_t block = task % block_count;
+                if (block == through) {
+                    return;
+                }
+                if (task < block_count) {
+                    RelaxBlock(pivot, GetBlock(block), pivot, workspace);
+                } else {
+                    RelaxBlock(GetBlock(block), pivot, pivot, workspace);
+                }
+            });
+            // Остальные блоки: одна задача — полоса строк; строки и столбцы полосы они берут из снимков
+            pool.Run(block_count, [&](size_t row_block) {
+                if (row_block == through) {
+                    return;
+                }
+                for (size_t column_block = 0; column_block < block_count; ++column_block) {
+                    if (column_block != through) {
+                        RelaxBlock(GetBlock(row_block), GetBlock(column_block), pivot, workspace);
                     }
-                    auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                    if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                        route_internal_data = RouteInternalData{edge.weight, edge_id};
+                }
+            });
+        }
+        StorePrevEdges(workspace.prev_edges);
+    }
+
+    template<typename Weight>
+    Router<Weight>::Router(const Router::Graph& graph, Router::RoutesInternalData&& routes_internal_data)
+            : graph_(graph)
+            , vertex_count_(graph.GetVertexCount()) {
+        if (routes_internal_data.size() != vertex_count_ * vertex_count_) {
+            throw std::invalid_argument("Routes internal data does not match the graph");
+        }
+        for (const WideEdgeId edge_id : routes_internal_data) {
+            if (edge_id != NO_ROUTE_EDGE && edge_id >= graph.GetEdgeCount()) {
+                throw std::invalid_argument("Routes internal data refers to a missing edge");
+            }
+        }
+        ValidateRoutesInternalData(graph, routes_internal_data);
+        StorePrevEdges(routes_internal_data);
+    }
+
+    template <typename Weight>
+    void Router<Weight>::ValidateRoutesInternalData(const Graph& graph,
+                                                    const RoutesInternalData& routes_internal_data) const {
+        // Для строки from: путь в вершину ещё не проверен, проверяется сейчас или уже доходит до from
+        enum class PathState : uint8_t { UNKNOWN, VISITING, REACHES_FROM };
+        std::vector<PathState> states(vertex_count_);
+        std::vector<VertexId> chain;
+        for (VertexId from = 0; from < vertex_count_; ++from) {
+            const size_t row = from * vertex_count_;
+            if (routes_internal_data[row + from] != NO_ROUTE_EDGE) {
+                throw std::invalid_argument("Routes internal data has a non-empty path from a vertex to itself");
+            }
+            std::fill(states.begin(), states.end(), PathState::UNKNOWN);
+            states[from] = PathState::REACHES_FROM;
+            for (VertexId to = 0; to < vertex_count_; ++to) {
+                // Каждая вершина проходится в строке один раз: цепочка обрывается на уже проверенной
+                VertexId vertex = to;
+                while (states[vertex] == PathState::UNKNOWN && routes_internal_data[row + vertex] != NO_ROUTE_EDGE) {
+                    const auto& edge = graph.GetEdge(routes_internal_data[row + vertex]);
+                    if (edge.to != vertex) {
+                        throw std::invalid_argument("Routes internal data has an edge that does not end at its vertex");
                     }
+                    states[vertex] = PathState::VISITING;
+                    chain.push_back(vertex);
+                    vertex = edge.from;
+                }
+                if (states[vertex] == PathState::VISITING) {
+                    throw std::invalid_argument("Routes internal data has a cyclic path");
+                }
+                if (!chain.empty() && states[vertex] != PathState::REACHES_FROM) {
+                    throw std::invalid_argument("Routes internal data has a path that does not start at its vertex");
+                }
+                for (const VertexId visited : chain) {
+                    states[visited] = PathState::REACHES_FROM;
                 }
+                chain.clear();
             }
         }
+    }
 
-        void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                        const RouteInternalData& route_to) {
-            auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-            const Weight candidate_weight = route_from.weight + route_to.weight;
-            if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-                route_relaxing = {candidate_weight,
-                                  route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+    template <typename Weight>
+    void Router<Weight>::InitializeRoutesInternalData(const Graph& graph, Workspace& workspace) const {
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            workspace.weights[vertex * vertex_count_ + vertex] = ZERO_WEIGHT;
+            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+                const auto edge = graph.GetEdge(edge_id);
+                if (edge.weight < ZERO_WEIGHT) {
+                    throw std::domain_error("Edges' weights should be non-negative");
+                }
+                const size_t index = vertex * vertex_count_ + edge.to;
+                if (workspace.weights[index] > edge.weight) {
+                    workspace.weights[index] = edge.weight;
+                    workspace.prev_edges[index] = static_cast<WideEdgeId>(edge_id);
+                }
             }
         }
+    }
+
+    template <typename Weight>
+    typename Router<Weight>::Span Router<Weight>::GetBlock(size_t block) const {
+        return {block * BLOCK_SIZE, std::min((block + 1) * BLOCK_SIZE, vertex_count_)};
+    }
 
-        void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-            for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-                if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                    for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                        if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                            RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+    template <typename Weight>
+    void Router<Weight>::RelaxBlock(Span rows, Span columns, Span through, Workspace& workspace) const {
+        for (VertexId vertex_through = through.begin; vertex_through < through.end; ++vertex_through) {
+            const size_t step = vertex_through - through.begin;
+            // Шаг через vertex_through не меняет её строку и столбец (вес петли — ноль), поэтому снимок
+            // в начале шага и есть их значение на этом шаге. Части строки и столбца вне блока
+            // сняты раньше: в диагональном блоке или в блоках строки и столбца полосы
+            if (rows.Contains(vertex_through)) {
+                const size_t row = vertex_through * vertex_count_;
+                std::copy(workspace.weights.begin() + row + columns.begin, workspace.weights.begin() + row + columns.end,
+                          workspace.row_weights.begin() + step * vertex_count_ + columns.begin);
+                std::copy(workspace.prev_edges.begin() + row + columns.begin, workspace.prev_edges.begin() + row + columns.end,
+                          workspace.row_edges.begin() + step * vertex_count_ + columns.begin);
+            }
+            if (columns.Contains(vertex_through)) {
+                for (VertexId vertex_from = rows.begin; vertex_from < rows.end; ++vertex_from) {
+                    workspace.column_weights[vertex_from * BLOCK_SIZE + step] = workspace.weights[vertex_from * vertex_count_ + vertex_through];
+                }
+            }
+
+            const Weight* through_weights = workspace.row_weights.data() + step * vertex_count_;
+            const WideEdgeId* through_edges = workspace.row_edges.data() + step * vertex_count_;
+            for (VertexId vertex_from = rows.begin; vertex_from < rows.end; ++vertex_from) {
+                const Weight weight_to_through = workspace.column_weights[vertex_from * BLOCK_SIZE + step];
+                if (weight_to_through == UNREACHABLE) {
+                    continue;
+                }
+                Weight* from_weights = workspace.weights.data() + vertex_from * vertex_count_;
+                WideEdgeId* from_edges = workspace.prev_edges.data() + vertex_from * vertex_count_;
+                // Путь в саму vertex_through через неё не короче, поэтому последнее ребро нового пути
+                // всегда из пути vertex_through -> vertex_to. Итерации не зависят друг от друга
+                if constexpr (std::is_same_v<Weight, double>) {
+                    min_plus::RelaxRow(weight_to_through, through_weights + columns.begin, through_edges + columns.begin,
+                                       from_weights + columns.begin, from_edges + columns.begin, columns.end - columns.begin);
+                } else {
+                    for (VertexId vertex_to = columns.begin; vertex_to < columns.end; ++vertex_to) {
+                        const Weight candidate = weight_to_through + through_weights[vertex_to];
+                        if (candidate < from_weights[vertex_to]) {
+                            from_weights[vertex_to] = candidate;
+                            from_edges[vertex_to] = through_edges[vertex_to];
                         }
                     }
                 }
             }
         }
+    }
 
-        static constexpr Weight ZERO_WEIGHT{};
-        const Graph& graph_;
-        RoutesInternalData routes_internal_data_;
-    };
+    template <typename Weight>
+    Router<Weight>::WorkerPool::WorkerPool(size_t thread_count) {
+        // Вызывающий поток тоже работает, поэтому создаётся на один меньше
+        for (size_t i = 1; i < thread_count; ++i) {
+            threads_.emplace_back([this] { Work(); });
+        }
+    }
 
     template <typename Weight>
-    Router<Weight>::Router(const Graph& graph)
-            : graph_(graph)
-            , routes_internal_data_(graph.GetVertexCount(),
-                                    std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
-    {
-        InitializeRoutesInternalData(graph);
+    Router<Weight>::WorkerPool::~WorkerPool() {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
 
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-            RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    template <typename Weight>
+    void Router<Weight>::WorkerPool::Run(size_t count, const std::function<void(size_t)>& task) {
+        if (threads_.empty()) {
+            for (size_t i = 0; i < count; ++i) {
+                task(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard lock(mutex_);
+            task_ = &task;
+            count_ = count;
+            next_ = 0;
+            active_ = threads_.size();
+            ++generation_;
         }
+        wake_.notify_all();
+        Drain(task, count);
+        std::unique_lock lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+        task_ = nullptr;
     }
 
-    template<typename Weight>
-    Router<Weight>::Router(const Router::Graph& graph, Router::RoutesInternalData&& routes_internal_data)
-            : graph_(graph), routes_internal_data_(routes_internal_data) {
+    template <typename Weight>
+    void Router<Weight>::WorkerPool::Work() {
+        uint64_t seen_generation = 0;
+        while (true) {
+            const std::function<void(size_t)>* task = nullptr;
+            size_t count = 0;
+            {
+                std::unique_lock lock(mutex_);
+                wake_.wait(lock, [this, seen_generation] { return stop_ || generation_ != seen_generation; });
+                if (stop_) {
+                    return;
+                }
+                seen_generation = generation_;
+                task = task_;
+                count = count_;
+            }
+            Drain(*task, count);
+            std::lock_guard lock(mutex_);
+            if (--active_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+
+    template <typename Weight>
+    void Router<Weight>::WorkerPool::Drain(const std::function<void(size_t)>& task, size_t count) {
+        for (size_t i = next_++; i < count; i = next_++) {
+            task(i);
+        }
+    }
+
+    template <typename Weight>
+    void Router<Weight>::StorePrevEdges(const std::vector<WideEdgeId>& prev_edges) {
+        if (graph_.GetEdgeCount() < NO_NARROW_EDGE) {
+            narrow_prev_edges_.resize(prev_edges.size());
+            std::transform(prev_edges.begin(), prev_edges.end(), narrow_prev_edges_.begin(), [](WideEdgeId edge_id) {
+                return edge_id == NO_WIDE_EDGE ? NO_NARROW_EDGE : static_cast<NarrowEdgeId>(edge_id);
+            });
+        } else {
+            wide_prev_edges_ = prev_edges;
+        }
+    }
+
+    template <typename Weight>
+    EdgeId Router<Weight>::GetPrevEdge(size_t index) const {
+        if (!narrow_prev_edges_.empty()) {
+            const NarrowEdgeId edge_id = narrow_prev_edges_[index];
+            return edge_id == NO_NARROW_EDGE ? NO_EDGE : edge_id;
+        }
+        const WideEdgeId edge_id = wide_prev_edges_[index];
+        return edge_id == NO_WIDE_EDGE ? NO_EDGE : edge_id;
     }
 
     template <typename Weight>
     std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                                  VertexId to) const {
-        const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-        if (!route_internal_data) {
+        if (from >= vertex_count_ || to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (from == to) {
+            return RouteInfo{ZERO_WEIGHT, {}};
+        }
+        const size_t row = from * vertex_count_;
+        EdgeId edge_id = GetPrevEdge(row + to);
+        if (edge_id == NO_EDGE) {
             return std::nullopt;
         }
-        const Weight weight = route_internal_data->weight;
         std::vector<EdgeId> edges;
-        for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-             edge_id;
-             edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
-        {
-            edges.push_back(*edge_id);
+        for (; edge_id != NO_EDGE; edge_id = GetPrevEdge(row + graph_.GetEdge(edge_id).from)) {
+            edges.push_back(edge_id);
         }
         std::reverse(edges.begin(), edges.end());
 
+        Weight weight = ZERO_WEIGHT;
+        for (const EdgeId path_edge : edges) {
+            weight += graph_.GetEdge(path_edge).weight;
+        }
         return RouteInfo{weight, std::move(edges)};
     }
 
+    template <typename Weight>
+    typename Router<Weight>::RoutesInternalData Router<Weight>::GetRoutesInternalData() const {
+        if (narrow_prev_edges_.empty()) {
+            return wide_prev_edges_;
+        }
+        RoutesInternalData routes(narrow_prev_edges_.size());
+        std::transform(narrow_prev_edges_.begin(), narrow_prev_edges_.end(), routes.begin(), [](NarrowEdgeId edge_id) {
+            return edge_id == NO_NARROW_EDGE ? NO_WIDE_EDGE : WideEdgeId{edge_id};
+        });
+        return routes;
+    }
+
+    template <typename Weight>
+    size_t Router<Weight>::GetMemoryUsage() const {
+        return narrow_prev_edges_.capacity() * sizeof(NarrowEdgeId) + wide_prev_edges_.capacity() * sizeof(WideEdgeId);
+    }
+
 }  // namespace graph
@@ -0,0 +1,759 @@
+#include "serialization.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace serialization {
+
+    namespace {
+
+        constexpr char MAGIC[4] = {'T', 'C', 'D', 'B'};
+        constexpr char ROUTER_STATE_MAGIC[4] = {'T', 'C', 'R', 'S'};
+        constexpr uint64_t SECTION_ALIGNMENT = 8;
+
+        uint64_t AlignUp(uint64_t offset) {
+            return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        }
+
+        // Раскладывает секции файла подряд с выравниванием и запоминает их положение в заголовке
+        class Layout {
+        public:
+            explicit Layout(std::string& buffer) : buffer_(buffer) {
+                buffer_.assign(sizeof(SnapshotHeader), '\0');
+            }
+
+            template <typename T>
+            SectionRef Append(const std::vector<T>& items) {
+                return Append(items.data(), items.size() * sizeof(T), items.size());
+            }
+
+            SectionRef Append(std::string_view bytes) {
+                return Append(bytes.data(), bytes.size(), bytes.size());
+            }
+
+        private:
+            SectionRef Append(const void* data, size_t bytes, size_t count) {
+                buffer_.resize(AlignUp(buffer_.size()), '\0');
+                SectionRef section{buffer_.size(), count};
+                buffer_.append(static_cast<const char*>(data), bytes);
+                return section;
+            }
+
+            std::string& buffer_;
+        };
+
+        class Writer {
+        public:
+            explicit Writer(std::ostream& out) : out_(out) {}
+
+            void Bytes(const void* data, size_t size) {
+                out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            }
+
+            void Varint(uint64_t value) {
+                char buf[10];
+                size_t size = 0;
+                while (value >= 0x80) {
+                    buf[size++] = static_cast<char>((value & 0x7F) | 0x80);
+                    value >>= 7;
+                }
+                buf[size++] = static_cast<char>(value);
+                Bytes(buf, size);
+            }
+
+            void Int(int value) {
+                // zigzag, чтобы отрицательные числа тоже кодировались коротко
+                Varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63));
+            }
+
+            void Double(double value) {
+                Bytes(&value, sizeof(value));
+            }
+
+            void String(std::string_view str) {
+                Varint(str.size());
+                Bytes(str.data(), str.size());
+            }
+
+        private:
+            std::ostream& out_;
+        };
+
+        // 64-битный FNV-1a: строки хэшируются вместе с длиной, чтобы границы между ними не сливались
+        class Fnv1a {
+        public:
+            void Bytes(const void* data, size_t size) {
+                const auto* bytes = static_cast<const unsigned char*>(data);
+                for (size_t i = 0; i < size; ++i) {
+                    hash_ = (hash_ ^ bytes[i]) * 0x100000001b3ull;
+                }
+            }
+
+            void Number(uint64_t value) {
+                Bytes(&value, sizeof(value));
+            }
+
+            void String(std::string_view str) {
+                Number(str.size());
+                Bytes(str.data(), str.size());
+            }
+
+            uint64_t Get() const {
+                return hash_;
+            }
+
+        private:
+            uint64_t hash_ = 0xcbf29ce484222325ull;
+        };
+
+        class Reader {
+        public:
+            explicit Reader(std::string_view data) : data_(data) {}
+
+            void Bytes(void* dst, size_t size) {
+                Require(size);
+                std::memcpy(dst, data_.data() + pos_, size);
+                pos_ += size;
+            }
+
+            uint64_t Varint() {
+                uint64_t result = 0;
+                for (int shift = 0; shift < 64; shift += 7) {
+                    Require(1);
+                    const uint8_t byte = static_cast<uint8_t>(data_[pos_++]);
+                    result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                    if ((byte & 0x80) == 0) {
+                        return result;
+                    }
+                }
+                throw SerializationError("Snapshot is corrupted: varint is too long");
+            }
+
+            int Int() {
+                const uint64_t value = Varint();
+                return static_cast<int>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1));
+            }
+
+            double Double() {
+                double value;
+                Bytes(&value, sizeof(value));
+                return value;
+            }
+
+            std::string_view String() {
+                const uint64_t size = Varint();
+                Require(size);
+                std::string_view result = data_.substr(pos_, size);
+                pos_ += size;
+                return result;
+            }
+
+            // Длина следующего массива; длина, для которой не хватит оставшихся байт, — признак повреждения
+            size_t Count(size_t item_size = 1) {
+                const uint64_t count = Varint();
+                if (count > (data_.size() - pos_) / item_size) {
+                    throw SerializationError("Snapshot is truncated");
+                }
+                return static_cast<size_t>(count);
+            }
+
+        private:
+            void Require(uint64_t size) const {
+                if (size > data_.size() - pos_) {
+                    throw SerializationError("Snapshot is truncated");
+                }
+            }
+
+            std::string_view data_;
+            size_t pos_ = 0;
+        };
+
+        void WriteColor(Writer& writer, const svg::Color& color) {
+            writer.Varint(color.index());
+            if (const auto* str = std::get_if<std::string>(&color)) {
+                writer.String(*str);
+            } else if (const auto* rgb = std::get_if<svg::Rgb>(&color)) {
+                writer.Varint(rgb->red);
+                writer.Varint(rgb->green);
+                writer.Varint(rgb->blue);
+            } else if (const auto* rgba = std::get_if<svg::Rgba>(&color)) {
+                writer.Varint(rgba->red);
+                writer.Varint(rgba->green);
+                writer.Varint(rgba->blue);
+                writer.Double(rgba->opacity);
+            }
+        }
+
+        svg::Color ReadColor(Reader& reader) {
+            switch (reader.Varint()) {
+            case 0:
+                return svg::NoneColor;
+            case 1:
+                return std::string{reader.String()};
+            case 2: {
+                svg::Rgb rgb;
+                rgb.red = static_cast<uint8_t>(reader.Varint());
+                rgb.green = static_cast<uint8_t>(reader.Varint());
+                rgb.blue = static_cast<uint8_t>(reader.Varint());
+                return rgb;
+            }
+            case 3: {
+                svg::Rgba rgba;
+                rgba.red = static_cast<uint8_t>(reader.Varint());
+                rgba.green = static_cast<uint8_t>(reader.Varint());
+                rgba.blue = static_cast<uint8_t>(reader.Varint());
+                rgba.opacity = reader.Double();
+                return rgba;
+            }
+            default:
+                throw SerializationError("Snapshot is corrupted: unknown color type");
+            }
+        }
+
+        void WriteRenderSettings(Writer& writer, const map_render::RenderSettings& settings) {
+            writer.Double(settings.width);
+            writer.Double(settings.height);
+            writer.Double(settings.padding);
+            writer.Double(settings.line_width);
+            writer.Double(settings.stop_radius);
+            writer.Int(settings.bus_label_font_size);
+            writer.Double(settings.bus_label_offset.x);
+            writer.Double(settings.bus_label_offset.y);
+            writer.Int(settings.stop_label_font_size);
+            writer.Double(settings.stop_label_offset.x);
+            writer.Double(settings.stop_label_offset.y);
+            WriteColor(writer, settings.underlayer_color);
+            writer.Double(settings.underlayer_width);
+            writer.Varint(settings.color_palette.size());
+            for (const svg::Color& color : settings.color_palette) {
+                WriteColor(writer, color);
+            }
+        }
+
+        map_render::RenderSettings ReadRenderSettings(Reader& reader) {
+            map_render::RenderSettings settings;
+            settings.width = reader.Double();
+            settings.height = reader.Double();
+            settings.padding = reader.Double();
+            settings.line_width = reader.Double();
+            settings.stop_radius = reader.Double();
+            settings.bus_label_font_size = reader.Int();
+            settings.bus_label_offset.x = reader.Double();
+            settings.bus_label_offset.y = reader.Double();
+            settings.stop_label_font_size = reader.Int();
+            settings.stop_label_offset.x = reader.Double();
+            settings.stop_label_offset.y = reader.Double();
+            settings.underlayer_color = ReadColor(reader);
+            settings.underlayer_width = reader.Double();
+            const uint64_t palette_size = reader.Varint();
+            for (uint64_t i = 0; i < palette_size; ++i) {
+                settings.color_palette.push_back(ReadColor(reader));
+            }
+            return settings;
+        }
+
+    }
+
+    SnapshotView::SnapshotView(std::span<const std::byte> data)
+            : data_(data) {
+        if (data_.size() < sizeof(SnapshotHeader)
+                || reinterpret_cast<uintptr_t>(data_.data()) % alignof(SnapshotHeader) != 0) {
+            throw SerializationError("Not a transport catalogue snapshot");
+        }
+        header_ = reinterpret_cast<const SnapshotHeader*>(data_.data());
+        if (!std::equal(std::begin(header_->magic), std::end(header_->magic), std::begin(MAGIC))) {
+            throw SerializationError("Not a transport catalogue snapshot");
+        }
+        if (header_->version != FORMAT_VERSION) {
+            throw SerializationError("Unsupported snapshot version " + std::to_string(header_->version));
+        }
+        if (header_->file_size != data_.size()) {
+            throw SerializationError("Snapshot is truncated");
+        }
+        const auto strings = Section<char>(header_->strings);
+        strings_ = {strings.data(), strings.size()};
+        // Проверяем границы остальных секций сразу, чтобы дальше обращаться к ним без проверок
+        Section<StopRecord>(header_->stops);
+        if (header_->coordinate_format == CoordinateFormat::DOUBLE) {
+            Section<double>(header_->coordinates);
+        } else if (header_->coordinate_format == CoordinateFormat::MICRODEGREES) {
+            Section<geo::CompactCoordinates>(header_->coordinates);
+        } else {
+            throw SerializationError("Snapshot is corrupted: unknown coordinate format");
+        }
+        if (header_->coordinates.size != header_->stops.size * (header_->coordinate_format == CoordinateFormat::DOUBLE ? 2 : 1)) {
+            throw SerializationError("Snapshot is corrupted: coordinates do not match stops");
+        }
+        Section<DistanceRecord>(header_->distances);
+        Section<BusRecord>(header_->buses);
+        Section<uint32_t>(header_->bus_stops);
+        Section<char>(header_->settings);
+    }
+
+    template <typename T>
+    std::span<const T> SnapshotView::Section(const SectionRef& section) const {
+        if (section.offset % alignof(T) != 0
+                || section.offset > data_.size()
+                || section.size > (data_.size() - section.offset) / sizeof(T)) {
+            throw SerializationError("Snapshot is corrupted: section out of range");
+        }
+        return {reinterpret_cast<const T*>(data_.data() + section.offset), static_cast<size_t>(section.size)};
+    }
+
+    std::span<const StopRecord> SnapshotView::Stops() const {
+        return Section<StopRecord>(header_->stops);
+    }
+
+    geo::Coordinates SnapshotView::StopCoordinates(size_t index) const {
+        if (header_->coordinate_format == CoordinateFormat::MICRODEGREES) {
+            return geo::Decode(Section<geo::CompactCoordinates>(header_->coordinates)[index]);
+        }
+        const auto coordinates = Section<double>(header_->coordinates);
+        return {coordinates[2 * index], coordinates[2 * index + 1]};
+    }
+
+    std::span<const DistanceRecord> SnapshotView::Distances() const {
+        return Section<DistanceRecord>(header_->distances);
+    }
+
+    std::span<const BusRecord> SnapshotView::Buses() const {
+        return Section<BusRecord>(header_->buses);
+    }
+
+    std::span<const uint32_t> SnapshotView::BusStops(const BusRecord& bus) const {
+        const auto bus_stops = Section<uint32_t>(header_->bus_stops);
+        if (bus.first_stop > bus_stops.size() || bus.stop_count > bus_stops.size() - bus.first_stop) {
+            throw SerializationError("Snapshot is corrupted: bus stops out of range");
+        }
+        return bus_stops.subspan(bus.first_stop, bus.stop_count);
+    }
+
+    std::string_view SnapshotView::Name(uint32_t offset, uint32_t size) const {
+        if (offset > strings_.size() || size > strings_.size() - offset) {
+            throw SerializationError("Snapshot is corrupted: name out of range");
+        }
+        return strings_.substr(offset, size);
+    }
+
+    std::optional<uint32_t> SnapshotView::GetDistance(uint32_t from, uint32_t to) const {
+        const auto distances = Distances();
+        const auto it = std::lower_bound(distances.begin(), distances.end(), std::pair{from, to},
+                [](const DistanceRecord& record, const std::pair<uint32_t, uint32_t>& key) {
+                    return std::pair{record.from, record.to} < key;
+                });
+        if (it == distances.end() || it->from != from || it->to != to) {
+            return std::nullopt;
+        }
+        return it->meters;
+    }
+
+    map_render::RenderSettings SnapshotView::GetRenderSettings() const {
+        const auto settings = Section<char>(header_->settings);
+        Reader reader({settings.data(), settings.size()});
+        return ReadRenderSettings(reader);
+    }
+
+    transport_router::RoutingSettings SnapshotView::GetRoutingSettings() const {
+        const auto settings = Section<char>(header_->settings);
+        Reader reader({settings.data(), settings.size()});
+        ReadRenderSettings(reader);
+        transport_router::RoutingSettings routing_settings;
+        routing_settings.bus_wait_time_ = reader.Double();
+        routing_settings.bus_velocity_ = reader.Double();
+        routing_settings.shard_count_ = static_cast<size_t>(reader.Varint());
+        const uint64_t engine = reader.Varint();
+        if (engine > static_cast<uint64_t>(transport_router::RouterEngine::RAPTOR)) {
+            throw SerializationError("Unknown router engine in snapshot");
+        }
+        routing_settings.router_engine_ = static_cast<transport_router::RouterEngine>(engine);
+        routing_settings.route_cache_bytes_ = static_cast<size_t>(reader.Varint());
+        routing_settings.tree_cache_bytes_ = static_cast<size_t>(reader.Varint());
+        const uint64_t graph_model = reader.Varint();
+        if (graph_model > static_cast<uint64_t>(transport_router::GraphModel::ROUTE_LINES)) {
+            throw SerializationError("Unknown graph model in snapshot");
+        }
+        routing_settings.graph_model_ = static_cast<transport_router::GraphModel>(graph_model);
+        return routing_settings;
+    }
+
+    MappedFile::MappedFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw SerializationError("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw SerializationError("Cannot map empty or unreadable file " + path);
+        }
+        void* data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            throw SerializationError("Cannot map " + path + ": " + std::strerror(errno));
+        }
+        data_ = static_cast<const std::byte*>(data);
+        size_ = static_cast<size_t>(st.st_size);
+    }
+
+    MappedFile::~MappedFile() {
+        ::munmap(const_cast<std::byte*>(data_), size_);
+    }
+
+    std::span<const std::byte> MappedFile::Data() const {
+        return {data_, size_};
+    }
+
+    void Serialize(const transport_catalogue::TransportCatalogue& catalogue,
+                   const map_render::RenderSettings& render_settings,
+                   const transport_router::RoutingSettings& routing_settings,
+                   std::ostream& out,
+                   CoordinateFormat coordinate_format) {
+        std::string strings;
+        const auto add_name = [&strings](std::string_view name) {
+            const auto offset = static_cast<uint32_t>(strings.size());
+            strings.append(name);
+            return std::pair{offset, static_cast<uint32_t>(name.size())};
+        };
+
+        std::unordered_map<const domain::Stop*, uint32_t> stop_index;
+        std::vector<StopRecord> stops;
+        std::vector<double> coordinates;
+        std::vector<geo::CompactCoordinates> compact_coordinates;
+        for (const domain::Stop& stop : catalogue.GetAllStops()) {
+            stop_index[&stop] = static_cast<uint32_t>(stops.size());
+            const auto [offset, size] = add_name(stop.name);
+            stops.push_back({offset, size});
+            if (coordinate_format == CoordinateFormat::MICRODEGREES) {
+                compact_coordinates.push_back(geo::Encode(stop.coordinates));
+            } else {
+                coordinates.push_back(stop.coordinates.lat);
+                coordinates.push_back(stop.coordinates.lng);
+            }
+        }
+
+        std::vector<DistanceRecord> distances;
+        for (const auto& [stops_pair, distance] : catalogue.GetDistances()) {
+            if (stops_pair.first != nullptr && stops_pair.second != nullptr) {
+                distances.push_back({stop_index.at(stops_pair.first), stop_index.at(stops_pair.second), distance});
+            }
+        }
+        // Отсортированный массив позволяет искать расстояние в снимке двоичным поиском
+        std::sort(distances.begin(), distances.end(), [](const DistanceRecord& lhs, const DistanceRecord& rhs) {
+            return std::pair{lhs.from, lhs.to} < std::pair{rhs.from, rhs.to};
+        });
+
+        std::vector<BusRecord> buses;
+        std::vector<uint32_t> bus_stops;
+        for (const domain::Bus& bus : catalogue.GetAllBuses()) {
+            const auto [offset, size] = add_name(bus.name);
+            buses.push_back({offset, size, static_cast<uint32_t>(bus_stops.size()),
+                             static_cast<uint32_t>(bus.stop.size()), bus.ring_route ? 1u : 0u});
+            for (const domain::Stop* stop : bus.stop) {
+                bus_stops.push_back(stop_index.at(stop));
+            }
+        }
+
+        std::ostringstream settings;
+        {
+            Writer writer(settings);
+            WriteRenderSettings(writer, render_settings);
+            writer.Double(routing_settings.bus_wait_time_);
+            writer.Double(routing_settings.bus_velocity_);
+            writer.Varint(routing_settings.shard_count_);
+            writer.Varint(static_cast<uint64_t>(routing_settings.router_engine_));
+            writer.Varint(routing_settings.route_cache_bytes_);
+            writer.Varint(routing_settings.tree_cache_bytes_);
+            writer.Varint(static_cast<uint64_t>(routing_settings.graph_model_));
+        }
+
+        SnapshotHeader header{};
+        std::copy(std::begin(MAGIC), std::end(MAGIC), header.magic);
+        header.version = FORMAT_VERSION;
+        header.coordinate_format = coordinate_format;
+
+        std::string buffer;
+        Layout layout(buffer);
+        header.strings = layout.Append(strings);
+        header.stops = layout.Append(stops);
+        header.coordinates = coordinate_format == CoordinateFormat::MICRODEGREES ? layout.Append(compact_coordinates)
+                                                                                  : layout.Append(coordinates);
+        header.distances = layout.Append(distances);
+        header.buses = layout.Append(buses);
+        header.bus_stops = layout.Append(bus_stops);
+        header.settings = layout.Append(settings.view());
+        buffer.resize(AlignUp(buffer.size()), '\0');
+        header.file_size = buffer.size();
+        std::memcpy(buffer.data(), &header, sizeof(header));
+
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if (!out) {
+            throw SerializationError("Failed to write snapshot");
+        }
+    }
+
+    void Deserialize(const SnapshotView& snapshot,
+                     transport_catalogue::TransportCatalogue& catalogue,
+                     map_render::RenderSettings& render_settings,
+                     transport_router::RoutingSettings& routing_settings) {
+        const auto stops = snapshot.Stops();
+        std::vector<std::string_view> stop_names;
+        stop_names.reserve(stops.size());
+        for (size_t i = 0; i < stops.size(); ++i) {
+            stop_names.push_back(snapshot.Name(stops[i].name_offset, stops[i].name_size));
+            catalogue.AddStop({std::string{stop_names.back()}, snapshot.StopCoordinates(i)});
+        }
+
+        const auto check_stop = [&stop_names](uint32_t index) {
+            if (index >= stop_names.size()) {
+                throw SerializationError("Snapshot is corrupted: stop index out of range");
+            }
+            return stop_names[index];
+        };
+
+        for (const DistanceRecord& record : snapshot.Distances()) {
+            catalogue.SetDistanceBetweenStop(check_stop(record.to), catalogue.FindStop(check_stop(record.from)), record.meters);
+        }
+
+        std::vector<std::string_view> route;
+        for (const BusRecord& record : snapshot.Buses()) {
+            route.clear();
+            for (uint32_t stop : snapshot.BusStops(record)) {
+                route.push_back(check_stop(stop));
+            }
+            catalogue.AddBus(snapshot.Name(record.name_offset, record.name_size), route, record.ring_route != 0);
+        }
+
+        render_settings = snapshot.GetRenderSettings();
+        routing_settings = snapshot.GetRoutingSettings();
+
+        catalogue.Freeze();
+    }
+
+    void Deserialize(std::istream& input,
+                     transport_catalogue::TransportCatalogue& catalogue,
+                     map_render::RenderSettings& render_settings,
+                     transport_router::RoutingSettings& routing_settings) {
+        std::ostringstream buffer;
+        buffer << input.rdbuf();
+        const std::string_view data = buffer.view();
+        // Копируем в выровненный буфер: записи снимка читаются на месте
+        std::vector<uint64_t> aligned((data.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        std::memcpy(aligned.data(), data.data(), data.size());
+        const SnapshotView snapshot({reinterpret_cast<const std::byte*>(aligned.data()), data.size()});
+        Deserialize(snapshot, catalogue, render_settings, routing_settings);
+    }
+
+    uint64_t CatalogueHash(const transport_catalogue::TransportCatalogue& catalogue) {
+        Fnv1a hash;
+        hash.Number(catalogue.GetStopCount());
+        for (const domain::Stop& stop : catalogue.GetAllStops()) {
+            hash.Number(stop.id);
+            hash.String(stop.name);
+        }
+
+        std::vector<DistanceRecord> distances;
+        for (const auto& [stops_pair, distance] : catalogue.GetDistances()) {
+            if (stops_pair.first != nullptr && stops_pair.second != nullptr) {
+                distances.push_back({static_cast<uint32_t>(stops_pair.first->id), static_cast<uint32_t>(stops_pair.second->id), distance});
+            }
+        }
+        // Порядок обхода хэш-таблицы не определён
+        std::sort(distances.begin(), distances.end(), [](const DistanceRecord& lhs, const DistanceRecord& rhs) {
+            return std::pair{lhs.from, lhs.to} < std::pair{rhs.from, rhs.to};
+        });
+        hash.Number(distances.size());
+        for (const DistanceRecord& record : distances) {
+            hash.Number(record.from);
+            hash.Number(record.to);
+            hash.Number(record.meters);
+        }
+
+        hash.Number(catalogue.GetAllBuses().size());
+        for (const domain::Bus& bus : catalogue.GetAllBuses()) {
+            hash.String(bus.name);
+            hash.Number(bus.ring_route ? 1 : 0);
+            hash.Number(bus.stop.size());
+            for (const domain::Stop* stop : bus.stop) {
+                hash.Number(stop->id);
+            }
+        }
+        return hash.Get();
+    }
+
+    void SerializeRouterState(const transport_router::TransportRouter& router,
+                              const transport_catalogue::TransportCatalogue& catalogue,
+                              std::ostream& out) {
+        using transport_router::EdgeType;
+        const transport_router::RouterState state = router.GetState();
+        const transport_router::RoutingSettings& settings = router.GetRoutingSettings();
+
+        Writer writer(out);
+        writer.Bytes(ROUTER_STATE_MAGIC, sizeof(ROUTER_STATE_MAGIC));
+        const uint64_t version = ROUTER_STATE_VERSION;
+        writer.Bytes(&version, sizeof(version));
+        const uint64_t hash = CatalogueHash(catalogue);
+        writer.Bytes(&hash, sizeof(hash));
+
+        writer.Double(settings.bus_wait_time_);
+        writer.Double(settings.bus_velocity_);
+        writer.Varint(static_cast<uint64_t>(settings.router_engine_));
+        writer.Varint(static_cast<uint64_t>(settings.graph_model_));
+
+        writer.Varint(state.vertex_count);
+        writer.Varint(state.edges.size());
+        for (const auto& edge : state.edges) {
+            writer.Varint(edge.from);
+            writer.Varint(edge.to);
+            writer.Double(edge.weight);
+        }
+        // Имена рёбер — по id остановки или маршрута: при загрузке они указывают в новый справочник
+        for (const transport_router::EdgeDescription& description : state.edges_descriptions) {
+            writer.Varint(static_cast<uint64_t>(description.type_));
+            if (description.type_ == EdgeType::BUS) {
+                const domain::Bus* bus = catalogue.FindBus(description.edge_name_);
+                if (bus == nullptr) {
+                    throw SerializationError("Router edge refers to a bus missing from the catalogue");
+                }
+                writer.Varint(bus->id);
+            } else {
+                const domain::Stop* stop = catalogue.FindStop(description.edge_name_);
+                if (stop == nullptr) {
+                    throw SerializationError("Router edge refers to a stop missing from the catalogue");
+                }
+                writer.Varint(stop->id);
+            }
+            writer.Double(description.time_);
+            writer.Varint(description.span_count_ ? static_cast<uint64_t>(*description.span_count_) + 1 : 0);
+        }
+
+        const auto vertex_code = [](graph::VertexId vertex) {
+            return vertex == transport_router::NO_VERTEX ? 0 : static_cast<uint64_t>(vertex) + 1;
+        };
+        writer.Varint(state.stop_vertices.size());
+        for (const auto& [wait, board] : state.stop_vertices) {
+            writer.Varint(vertex_code(wait));
+            writer.Varint(vertex_code(board));
+        }
+        writer.Varint(state.vertex_stops.size());
+        for (const size_t stop : state.vertex_stops) {
+            writer.Varint(stop);
+        }
+
+        writer.Varint(state.routes ? 1 : 0);
+        if (state.routes) {
+            writer.Varint(state.routes->size());
+            writer.Bytes(state.routes->data(), state.routes->size() * sizeof(uint32_t));
+        }
+        if (!out) {
+            throw SerializationError("Failed to write router state");
+        }
+    }
+
+    transport_router::RouterState DeserializeRouterState(std::istream& input,
+                                                         const transport_catalogue::TransportCatalogue& catalogue,
+                                                         const transport_router::RoutingSettings& settings) {
+        using transport_router::EdgeType;
+        std::ostringstream buffer;
+        buffer << input.rdbuf();
+        Reader reader(buffer.view());
+
+        char magic[sizeof(ROUTER_STATE_MAGIC)];
+        reader.Bytes(magic, sizeof(magic));
+        if (!std::equal(std::begin(magic), std::end(magic), std::begin(ROUTER_STATE_MAGIC))) {
+            throw SerializationError("Not a router state file");
+        }
+        uint64_t version = 0;
+        reader.Bytes(&version, sizeof(version));
+        if (version != ROUTER_STATE_VERSION) {
+            throw SerializationError("Unsupported router state version " + std::to_string(version));
+        }
+        uint64_t hash = 0;
+        reader.Bytes(&hash, sizeof(hash));
+        if (hash != CatalogueHash(catalogue)) {
+            throw SerializationError("Router state was built for a different catalogue");
+        }
+
+        const double bus_wait_time = reader.Double();
+        const double bus_velocity = reader.Double();
+        const uint64_t engine = reader.Varint();
+        const uint64_t graph_model = reader.Varint();
+        if (bus_wait_time != settings.bus_wait_time_ || bus_velocity != settings.bus_velocity_
+                || engine != static_cast<uint64_t>(settings.router_engine_)
+                || graph_model != static_cast<uint64_t>(settings.graph_model_)) {
+            throw SerializationError("Router state was built with different routing settings");
+        }
+
+        // У RAPTOR графа нет и состояние пустое, у остальных таблица покрывает все вершины графа своей модели
+        const size_t expected_vertex_count = settings.router_engine_ == transport_router::RouterEngine::RAPTOR
+                ? 0 : transport_router::GetGraphVertexCount(catalogue, settings.graph_model_);
+        transport_router::RouterState state;
+        state.vertex_count = static_cast<size_t>(reader.Varint());
+        if (state.vertex_count != expected_vertex_count) {
+            throw SerializationError("Router state is corrupted: vertex count does not match the graph model");
+        }
+        const size_t edge_count = reader.Count();
+        state.edges.reserve(edge_count);
+        for (size_t i = 0; i < edge_count; ++i) {
+            const uint64_t from = reader.Varint();
+            const uint64_t to = reader.Varint();
+            if (from >= state.vertex_count || to >= state.vertex_count) {
+                throw SerializationError("Router state is corrupted: edge vertex out of range");
+            }
+            state.edges.push_back({static_cast<graph::VertexId>(from), static_cast<graph::VertexId>(to), reader.Double()});
+        }
+
+        const auto& stops = catalogue.GetAllStops();
+        const auto& buses = catalogue.GetAllBuses();
+        state.edges_descriptions.reserve(edge_count);
+        for (size_t i = 0; i < edge_count; ++i) {
+            const uint64_t type = reader.Varint();
+            if (type > static_cast<uint64_t>(EdgeType::ALIGHT)) {
+                throw SerializationError("Router state is corrupted: unknown edge type");
+            }
+            const uint64_t id = reader.Varint();
+            if (id >= (type == static_cast<uint64_t>(EdgeType::BUS) ? buses.size() : stops.size())) {
+                throw SerializationError("Router state is corrupted: edge name out of range");
+            }
+            transport_router::EdgeDescription description{static_cast<EdgeType>(type),
+                    type == static_cast<uint64_t>(EdgeType::BUS) ? std::string_view(buses[id].name) : std::string_view(stops[id].name)};
+            description.time_ = reader.Double();
+            const uint64_t span = reader.Varint();
+            description.span_count_ = span == 0 ? std::nullopt : std::optional<int>(static_cast<int>(span - 1));
+            state.edges_descriptions.push_back(description);
+        }
+
+        const auto vertex_from_code = [](uint64_t code) {
+            return code == 0 ? transport_router::NO_VERTEX : static_cast<graph::VertexId>(code - 1);
+        };
+        state.stop_vertices.resize(reader.Count(2));
+        for (auto& [wait, board] : state.stop_vertices) {
+            wait = vertex_from_code(reader.Varint());
+            board = vertex_from_code(reader.Varint());
+        }
+        state.vertex_stops.resize(reader.Count());
+        for (size_t& stop : state.vertex_stops) {
+            stop = static_cast<size_t>(reader.Varint());
+            if (stop >= stops.size()) {
+                throw SerializationError("Router state is corrupted: vertex stop out of range");
+            }
+        }
+        if (state.vertex_stops.size() != state.vertex_count) {
+            throw SerializationError("Router state is corrupted: vertex table does not match the graph model");
+        }
+
+        if (reader.Varint() != 0) {
+            state.routes.emplace(reader.Count(sizeof(uint32_t)));
+            reader.Bytes(state.routes->data(), state.routes->size() * sizeof(uint32_t));
+        }
+        return state;
+    }
+
+}
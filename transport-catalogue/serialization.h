@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "transport_catalogue.h"
+#include "map_renderer.h"
+#include "transport_router.h"
+
+/*
+ * Бинарный снимок транспортного справочника.
+ * make_base сохраняет в файл загруженный справочник вместе с настройками отрисовки и маршрутизации,
+ * process_requests восстанавливает его без разбора JSON базы.
+ *
+ * Формат — проверяемый бинарный снимок: все секции выровнены на 8 байт, записи имеют фиксированный
+ * размер, имена лежат в общем пуле строк, порядок байт — родной для машины (little-endian).
+ * SnapshotView один раз проверяет заголовок и границы секций, после чего записи читаются на месте,
+ * без пословного разбора. Загрузка — это разбор в обычный справочник в куче: справочник не ссылается
+ * на файл, и общих между процессами страниц с данными справочника нет.
+ *
+ *   SnapshotHeader
+ *   строки:     пул имён остановок и маршрутов
+ *   остановки:  StopRecord[]
+ *   координаты: double[2] или geo::CompactCoordinates на остановку, в зависимости от coordinate_format
+ *   расстояния: DistanceRecord[], отсортированы по (from, to)
+ *   маршруты:   BusRecord[]
+ *   остановки маршрутов: uint32_t[] — индексы остановок, маршрут ссылается на непрерывный отрезок
+ *   настройки:  отрисовка и маршрутизация (varint, вещественные — 8 байт IEEE 754)
+ */
+namespace serialization {
+
+    constexpr uint32_t FORMAT_VERSION = 9;
+
+    class SerializationError : public std::runtime_error {
+    public:
+        using runtime_error::runtime_error;
+    };
+
+    // Способ хранения координат остановок в снимке
+    enum class CoordinateFormat : uint32_t {
+        DOUBLE = 0,       // Без потерь, 16 байт на остановку
+        MICRODEGREES = 1  // geo::CompactCoordinates, 8 байт на остановку, точность 1e-6 градуса
+    };
+
+    struct SerializationSettings {
+        std::string file;
+        CoordinateFormat coordinate_format = CoordinateFormat::DOUBLE;
+        std::string router_file; // Файл состояния маршрутизатора, пусто — маршрутизатор строится при каждом запуске
+    };
+
+    struct SectionRef {
+        uint64_t offset = 0; // Смещение от начала файла в байтах
+        uint64_t size = 0;   // Количество элементов (для строк и настроек — байт)
+    };
+
+    struct SnapshotHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t file_size;
+        CoordinateFormat coordinate_format;
+        uint32_t reserved;
+        SectionRef strings;
+        SectionRef stops;
+        SectionRef coordinates;
+        SectionRef distances;
+        SectionRef buses;
+        SectionRef bus_stops;
+        SectionRef settings;
+    };
+
+    struct StopRecord {
+        uint32_t name_offset;
+        uint32_t name_size;
+    };
+
+    struct DistanceRecord {
+        uint32_t from;
+        uint32_t to;
+        uint32_t meters;
+    };
+
+    struct BusRecord {
+        uint32_t name_offset;
+        uint32_t name_size;
+        uint32_t first_stop; // Начало отрезка в секции остановок маршрутов
+        uint32_t stop_count;
+        uint32_t ring_route;
+    };
+
+    /**
+     * Представление снимка поверх непрерывного буфера (обычно отображённого в память файла).
+     * Ничего не копирует: имена — string_view, массивы — span на тот же буфер.
+     * Буфер должен жить дольше представления.
+     */
+    class SnapshotView {
+    public:
+        // Проверяет заголовок и границы всех секций, при ошибке бросает SerializationError
+        explicit SnapshotView(std::span<const std::byte> data);
+
+        std::span<const StopRecord> Stops() const;
+        // Координаты остановки с индексом index, раскодируются при обращении
+        geo::Coordinates StopCoordinates(size_t index) const;
+        std::span<const DistanceRecord> Distances() const;
+        std::span<const BusRecord> Buses() const;
+        std::span<const uint32_t> BusStops(const BusRecord& bus) const;
+        std::string_view Name(uint32_t offset, uint32_t size) const;
+        // Расстояние от остановки from до остановки to, если оно задано
+        std::optional<uint32_t> GetDistance(uint32_t from, uint32_t to) const;
+
+        map_render::RenderSettings GetRenderSettings() const;
+        transport_router::RoutingSettings GetRoutingSettings() const;
+
+    private:
+        template <typename T>
+        std::span<const T> Section(const SectionRef& section) const;
+
+        std::span<const std::byte> data_;
+        const SnapshotHeader* header_ = nullptr;
+        std::string_view strings_;
+    };
+
+    // Файл, отображённый в память только для чтения; нужен только на время Deserialize
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path);
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        std::span<const std::byte> Data() const;
+
+    private:
+        const std::byte* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    void Serialize(const transport_catalogue::TransportCatalogue& catalogue,
+                   const map_render::RenderSettings& render_settings,
+                   const transport_router::RoutingSettings& routing_settings,
+                   std::ostream& out,
+                   CoordinateFormat coordinate_format = CoordinateFormat::DOUBLE);
+
+    // Заполняет пустой справочник и настройки из снимка, при повреждённом снимке бросает SerializationError
+    void Deserialize(const SnapshotView& snapshot,
+                     transport_catalogue::TransportCatalogue& catalogue,
+                     map_render::RenderSettings& render_settings,
+                     transport_router::RoutingSettings& routing_settings);
+
+    void Deserialize(std::istream& input,
+                     transport_catalogue::TransportCatalogue& catalogue,
+                     map_render::RenderSettings& render_settings,
+                     transport_router::RoutingSettings& routing_settings);
+
+    /*
+     * Состояние маршрутизатора (transport_router::RouterState) в отдельном файле: граф, описания рёбер,
+     * вершины остановок и матрица Флойда–Уоршелла сохраняются один раз в make_base, а process_requests
+     * не тратит время на их построение. Файл привязан к справочнику хэшем его содержимого и к настройкам
+     * маршрутизации, от которых зависит граф; при несовпадении загрузка отказывает.
+     *
+     *   "TCRS", версия ROUTER_STATE_VERSION, хэш справочника (CatalogueHash) — по 8 байт
+     *   настройки: bus_wait_time, bus_velocity, router_engine, graph_model
+     *   граф:      число вершин, рёбра (from, to — varint, вес — double) в порядке id
+     *   описания:  тип, id остановки или маршрута, время, span_count + 1 (0 — нет)
+     *   вершины:   пары вершин остановок (NO_VERTEX — 0, иначе id + 1), остановки вершин
+     *   матрица:   признак наличия, размер и последние рёбра путей (uint32_t)
+     */
+    constexpr uint64_t ROUTER_STATE_VERSION = 1;
+
+    /**
+     * Хэш (FNV-1a) всего, из чего строится граф маршрутизатора: имён остановок по id, дорожных расстояний
+     * и маршрутов с их остановками. Координаты не входят: граф от них не зависит, а в снимке с
+     * compact_coordinates они хранятся с потерей точности.
+     */
+    uint64_t CatalogueHash(const transport_catalogue::TransportCatalogue& catalogue);
+
+    // catalogue — справочник, по которому построен router (или его копия)
+    void SerializeRouterState(const transport_router::TransportRouter& router,
+                              const transport_catalogue::TransportCatalogue& catalogue,
+                              std::ostream& out);
+
+    /**
+     * Читает состояние для TransportRouter над catalogue с настройками settings: имена в описаниях рёбер
+     * указывают в catalogue. Бросает SerializationError, если файл повреждён, построен по другому
+     * справочнику или с другими настройками.
+     */
+    transport_router::RouterState DeserializeRouterState(std::istream& input,
+                                                         const transport_catalogue::TransportCatalogue& catalogue,
+                                                         const transport_router::RoutingSettings& settings);
+
+}
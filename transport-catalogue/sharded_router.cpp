@@ -0,0 +1,392 @@
+#include "sharded_router.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+using namespace std::literals;
+
+namespace sharded_router {
+
+    namespace {
+        double TotalTime(const transport_router::EdgeDescriptions& route) {
+            double total = 0.0;
+            for (const auto& description : route) {
+                total += description.time_;
+            }
+            return total;
+        }
+    }
+
+    ShardedRouter::ShardedRouter(transport_router::RoutingSettings settings,
+                                 const transport_catalogue::TransportCatalogue& catalogue,
+                                 size_t shard_count)
+            : routing_settings_(settings),
+              catalogue_(catalogue) {
+        SplitIntoShards(shard_count);
+        BuildShards();
+        BuildOverlay();
+    }
+
+    size_t ShardedRouter::GetShardCount() const {
+        return shards_.size();
+    }
+
+    size_t ShardedRouter::GetShardOf(const domain::Stop* stop) const {
+        return stop == nullptr ? NO_SHARD : stop_shard_[stop->id];
+    }
+
+    size_t ShardedRouter::GetBoundaryStopCount() const {
+        return overlay_graph_->GetVertexCount() / 2;
+    }
+
+    // Полосы по долготе с равным числом остановок, через которые проходят маршруты
+    void ShardedRouter::SplitIntoShards(size_t shard_count) {
+        std::vector<const domain::Stop*> used;
+        for (std::string_view name : catalogue_.GetUsedStopNames()) {
+            used.push_back(catalogue_.FindStop(name));
+        }
+        std::sort(used.begin(), used.end(), [](const domain::Stop* lhs, const domain::Stop* rhs) {
+            return std::pair{lhs->coordinates.lng, lhs->id} < std::pair{rhs->coordinates.lng, rhs->id};
+        });
+
+        shard_count = std::clamp<size_t>(shard_count, 1, std::max<size_t>(used.size(), 1));
+        shards_.resize(shard_count);
+        stop_shard_.assign(catalogue_.GetStopCount(), NO_SHARD);
+        for (size_t i = 0; i < used.size(); ++i) {
+            stop_shard_[used[i]->id] = i * shard_count / used.size();
+        }
+    }
+
+    void ShardedRouter::BuildShards() {
+        std::vector<transport_catalogue::TransportCatalogue> catalogues(shards_.size());
+        for (const domain::Stop& stop : catalogue_.GetAllStops()) {
+            if (stop_shard_[stop.id] != NO_SHARD) {
+                catalogues[stop_shard_[stop.id]].AddStop(stop);
+            }
+        }
+        for (const auto& [stops_pair, distance] : catalogue_.GetDistances()) {
+            const size_t shard = GetShardOf(stops_pair.first);
+            if (shard != NO_SHARD && stops_pair.second != nullptr && shard == GetShardOf(stops_pair.second)) {
+                auto& shard_catalogue = catalogues[shard];
+                shard_catalogue.SetDistanceBetweenStop(stops_pair.second->name, shard_catalogue.FindStop(stops_pair.first->name), distance);
+            }
+        }
+
+        cross_shard_bus_.assign(catalogue_.GetAllBuses().size(), false);
+        for (const domain::Bus& bus : catalogue_.GetAllBuses()) {
+            if (bus.stop.empty()) {
+                continue;
+            }
+            const domain::RouteView route(bus);
+            const bool single_shard = std::all_of(bus.stop.begin(), bus.stop.end(), [this, &bus](const domain::Stop* stop) {
+                return stop_shard_[stop->id] == stop_shard_[bus.stop.front()->id];
+            });
+            if (single_shard) {
+                const size_t shard = stop_shard_[bus.stop.front()->id];
+                std::vector<std::string_view> stops;
+                for (const domain::Stop* stop : bus.stop) {
+                    stops.push_back(stop->name);
+                }
+                catalogues[shard].AddBus(bus.name, stops, bus.ring_route);
+                shards_[shard].bus_names.emplace(bus.name, bus.name);
+                continue;
+            }
+
+            // Межшардовый маршрут: каждый отрезок полного маршрута внутри одного шарда
+            // добавляется в справочник шарда отдельным маршрутом в одну сторону
+            cross_shard_bus_[bus.id] = true;
+            size_t piece = 0;
+            for (size_t begin = 0; begin < route.size();) {
+                const size_t shard = stop_shard_[route[begin]->id];
+                size_t end = begin + 1;
+                while (end < route.size() && stop_shard_[route[end]->id] == shard) {
+                    ++end;
+                }
+                if (end - begin > 1) {
+                    std::vector<std::string_view> stops;
+                    for (size_t i = begin; i < end; ++i) {
+                        stops.push_back(route[i]->name);
+                    }
+                    // Разделитель, которого нет в именах из JSON, чтобы не совпасть с настоящим маршрутом
+                    std::string piece_name = std::string{bus.name} + "\x1F"s + std::to_string(piece++);
+                    catalogues[shard].AddBus(piece_name, stops, true);
+                    shards_[shard].bus_names.emplace(std::move(piece_name), bus.name);
+                }
+                begin = end;
+            }
+        }
+
+        // Общая ёмкость кэша маршрутов делится между шардами поровну
+        transport_router::RoutingSettings shard_settings = routing_settings_;
+        shard_settings.route_cache_bytes_ /= shards_.size();
+        // Пути до граничных остановок и сокращения запрашиваются у шардов пачками с общим началом или концом
+        shard_settings.tree_cache_bytes_ /= shards_.size();
+        for (size_t shard = 0; shard < shards_.size(); ++shard) {
+            catalogues[shard].Freeze();
+            shards_[shard].router = std::make_unique<transport_router::TransportRouter>(shard_settings,
+                    std::make_unique<transport_catalogue::TransportCatalogue>(std::move(catalogues[shard])));
+        }
+    }
+
+    void ShardedRouter::BuildOverlay() {
+        // Поездка из позиции from полного маршрута выходит из её шарда, если до неё доходит позиция leave[from]
+        struct CrossingBus {
+            const domain::Bus* bus;
+            std::vector<size_t> leave;
+        };
+        std::vector<CrossingBus> crossing_buses;
+        std::vector<bool> is_entry(catalogue_.GetStopCount(), false);
+        std::vector<bool> is_exit(catalogue_.GetStopCount(), false);
+        for (const domain::Bus& bus : catalogue_.GetAllBuses()) {
+            if (!cross_shard_bus_[bus.id]) {
+                continue;
+            }
+            const domain::RouteView route(bus);
+            std::vector<size_t> leave(route.size(), route.size());
+            for (size_t from = route.size() - 1; from-- > 0;) {
+                leave[from] = stop_shard_[route[from + 1]->id] != stop_shard_[route[from]->id] ? from + 1 : leave[from + 1];
+            }
+            for (size_t from = 0; from + 1 < route.size(); ++from) {
+                if (leave[from] == route.size()) {
+                    continue;
+                }
+                is_exit[route[from]->id] = true;
+                for (size_t to = leave[from]; to < route.size(); ++to) {
+                    is_entry[route[to]->id] = true;
+                }
+            }
+            crossing_buses.push_back({&bus, std::move(leave)});
+        }
+
+        overlay_vertex_.assign(catalogue_.GetStopCount(), transport_router::NO_VERTEX);
+        std::vector<const domain::Stop*> boundary_stops;
+        for (const domain::Stop& stop : catalogue_.GetAllStops()) {
+            if (!is_entry[stop.id] && !is_exit[stop.id]) {
+                continue;
+            }
+            overlay_vertex_[stop.id] = static_cast<graph::VertexId>(boundary_stops.size() * 2);
+            boundary_stops.push_back(&stop);
+            Shard& shard = shards_[stop_shard_[stop.id]];
+            if (is_entry[stop.id]) {
+                shard.entry_stops.push_back(&stop);
+            }
+            if (is_exit[stop.id]) {
+                shard.exit_stops.push_back(&stop);
+            }
+        }
+
+        transport_router::GraphBuilder builder(boundary_stops.size() * 2);
+        const auto add_edge = [this, &builder](graph::VertexId from, graph::VertexId to, double weight, OverlayEdge edge) {
+            builder.AddEdge({from, to, weight});
+            overlay_edges_.push_back(std::move(edge));
+        };
+
+        for (const domain::Stop* stop : boundary_stops) {
+            const graph::VertexId wait = overlay_vertex_[stop->id];
+            add_edge(wait, wait + 1, routing_settings_.bus_wait_time_,
+                     {{transport_router::EdgeType::WAIT, stop->name, routing_settings_.bus_wait_time_, std::nullopt}});
+        }
+
+        const double minutes_per_meter = transport_router::MIN_PER_HOUR / transport_router::METERS_PER_KM / routing_settings_.bus_velocity_;
+        for (const auto& [bus, leave] : crossing_buses) {
+            const domain::RouteView route(*bus);
+            for (size_t from = 0; from + 1 < route.size(); ++from) {
+                for (size_t to = leave[from]; to < route.size(); ++to) {
+                    const double time = catalogue_.GetRoadDistanceOnBus(*bus, from, to) * minutes_per_meter;
+                    add_edge(overlay_vertex_[route[from]->id] + 1, overlay_vertex_[route[to]->id], time,
+                             {{transport_router::EdgeType::BUS, bus->name, time, static_cast<int>(to - from)}});
+                }
+            }
+        }
+
+        for (size_t shard = 0; shard < shards_.size(); ++shard) {
+            std::vector<std::pair<const domain::Stop*, const domain::Stop*>> queries;
+            for (const domain::Stop* from : shards_[shard].entry_stops) {
+                for (const domain::Stop* to : shards_[shard].exit_stops) {
+                    if (from != to) {
+                        queries.emplace_back(from, to);
+                    }
+                }
+            }
+            const auto routes = BuildShardRoutes(shard, queries);
+            for (size_t i = 0; i < queries.size(); ++i) {
+                if (routes[i]) {
+                    const auto [from, to] = queries[i];
+                    add_edge(overlay_vertex_[from->id], overlay_vertex_[to->id], TotalTime(*routes[i]), {{}, from, to, true});
+                }
+            }
+        }
+
+        overlay_graph_ = std::make_unique<transport_router::Graph>(builder.Build());
+        overlay_edges_ = builder.Reorder(std::move(overlay_edges_));
+    }
+
+    // Имена в маршруте шарда переводятся обратно в имена исходного справочника
+    void ShardedRouter::TranslateShardRoute(size_t shard, transport_router::EdgeDescriptions& route) const {
+        for (auto& description : route) {
+            if (description.type_ == transport_router::EdgeType::WAIT) {
+                description.edge_name_ = catalogue_.FindStop(description.edge_name_)->name;
+            } else {
+                description.edge_name_ = shards_[shard].bus_names.find(description.edge_name_)->second;
+            }
+        }
+    }
+
+    std::optional<transport_router::EdgeDescriptions> ShardedRouter::BuildShardRoute(size_t shard,
+            const domain::Stop* from, const domain::Stop* to) const {
+        auto route = shards_[shard].router->BuildRoute(from->name, to->name);
+        if (route) {
+            TranslateShardRoute(shard, *route);
+        }
+        return route;
+    }
+
+    std::vector<std::optional<transport_router::EdgeDescriptions>> ShardedRouter::BuildShardRoutes(size_t shard,
+            const std::vector<std::pair<const domain::Stop*, const domain::Stop*>>& queries) const {
+        std::vector<transport_router::RouteQuery> names;
+        names.reserve(queries.size());
+        for (const auto& [from, to] : queries) {
+            names.emplace_back(from->name, to->name);
+        }
+        auto routes = shards_[shard].router->BuildRoutes(names);
+        for (auto& route : routes) {
+            if (route) {
+                TranslateShardRoute(shard, *route);
+            }
+        }
+        return routes;
+    }
+
+    void ShardedRouter::AppendOverlayRoute(const transport_router::RouterBase::RouteInfo& route,
+                                           transport_router::EdgeDescriptions& result) const {
+        for (graph::EdgeId id : route.edges) {
+            const OverlayEdge& edge = overlay_edges_[id];
+            if (!edge.shortcut) {
+                result.push_back(edge.description);
+                continue;
+            }
+            const auto inner = BuildShardRoute(GetShardOf(edge.from), edge.from, edge.to);
+            result.insert(result.end(), inner->begin(), inner->end());
+        }
+    }
+
+    /**
+     * Дейкстра от нескольких источников: вершины ожидания heads стартуют со временем пути до них от from.
+     * Путь до вершины ожидания tail завершается прибавлением времени tail до to; поиск останавливается,
+     * когда извлечённое время не меньше лучшего найденного полного пути или time_limit.
+     */
+    std::optional<std::tuple<transport_router::RouterBase::RouteInfo, size_t, size_t>> ShardedRouter::SearchOverlay(
+            const std::vector<Leg>& heads, const std::vector<Leg>& tails, double time_limit) const {
+        constexpr size_t NONE = std::numeric_limits<size_t>::max();
+        const size_t vertex_count = overlay_graph_->GetVertexCount();
+        std::vector<double> times(vertex_count, std::numeric_limits<double>::infinity());
+        std::vector<graph::EdgeId> prev_edges(vertex_count, NONE);
+        std::vector<size_t> head_of(vertex_count, NONE); // Для вершин ожидания heads: индекс в heads
+        std::vector<size_t> tail_of(vertex_count, NONE);
+        for (size_t i = 0; i < tails.size(); ++i) {
+            tail_of[overlay_vertex_[tails[i].boundary->id]] = i;
+        }
+
+        using HeapEntry = std::pair<double, graph::VertexId>;
+        std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<>> heap;
+        for (size_t i = 0; i < heads.size(); ++i) {
+            const graph::VertexId vertex = overlay_vertex_[heads[i].boundary->id];
+            if (heads[i].time < times[vertex]) {
+                times[vertex] = heads[i].time;
+                head_of[vertex] = i;
+                heap.emplace(heads[i].time, vertex);
+            }
+        }
+
+        double best_time = time_limit;
+        graph::VertexId best_vertex = transport_router::NO_VERTEX;
+        while (!heap.empty()) {
+            const auto [time, vertex] = heap.top();
+            heap.pop();
+            if (time >= best_time) {
+                break;
+            }
+            if (time > times[vertex]) {
+                continue;
+            }
+            if (tail_of[vertex] != NONE && time + tails[tail_of[vertex]].time < best_time) {
+                best_time = time + tails[tail_of[vertex]].time;
+                best_vertex = vertex;
+            }
+            for (const graph::EdgeId edge_id : overlay_graph_->GetIncidentEdges(vertex)) {
+                const auto edge = overlay_graph_->GetEdge(edge_id);
+                if (time + edge.weight < times[edge.to]) {
+                    times[edge.to] = time + edge.weight;
+                    prev_edges[edge.to] = edge_id;
+                    head_of[edge.to] = NONE;
+                    heap.emplace(times[edge.to], edge.to);
+                }
+            }
+        }
+        if (best_vertex == transport_router::NO_VERTEX) {
+            return std::nullopt;
+        }
+
+        transport_router::RouterBase::RouteInfo route{times[best_vertex], {}};
+        graph::VertexId vertex = best_vertex;
+        for (; prev_edges[vertex] != NONE; vertex = overlay_graph_->GetEdge(prev_edges[vertex]).from) {
+            route.edges.push_back(prev_edges[vertex]);
+        }
+        std::reverse(route.edges.begin(), route.edges.end());
+        route.weight -= heads[head_of[vertex]].time;
+        return std::tuple{std::move(route), head_of[vertex], tail_of[best_vertex]};
+    }
+
+    std::optional<transport_router::EdgeDescriptions> ShardedRouter::BuildRoute(std::string_view stop_from, std::string_view stop_to) const {
+        if (stop_from == stop_to) {
+            return transport_router::EdgeDescriptions{};
+        }
+        const domain::Stop* from = catalogue_.FindStop(stop_from);
+        const domain::Stop* to = catalogue_.FindStop(stop_to);
+        const size_t from_shard = GetShardOf(from);
+        const size_t to_shard = GetShardOf(to);
+        if (from_shard == NO_SHARD || to_shard == NO_SHARD) {
+            return std::nullopt;
+        }
+
+        std::optional<transport_router::EdgeDescriptions> best;
+        double best_time = std::numeric_limits<double>::infinity();
+        if (from_shard == to_shard) {
+            best = BuildShardRoute(from_shard, from, to);
+            if (best) {
+                best_time = TotalTime(*best);
+            }
+        }
+
+        // Подходы к выходам шарда from и отходы от входов шарда to, каждые одной пачкой
+        const auto collect_legs = [this](size_t shard, const std::vector<const domain::Stop*>& boundaries,
+                                         const domain::Stop* stop, bool towards_boundary) {
+            std::vector<std::pair<const domain::Stop*, const domain::Stop*>> queries;
+            for (const domain::Stop* boundary : boundaries) {
+                queries.emplace_back(towards_boundary ? stop : boundary, towards_boundary ? boundary : stop);
+            }
+            auto routes = BuildShardRoutes(shard, queries);
+            std::vector<Leg> legs;
+            for (size_t i = 0; i < routes.size(); ++i) {
+                if (routes[i]) {
+                    const double time = TotalTime(*routes[i]);
+                    legs.push_back({boundaries[i], std::move(*routes[i]), time});
+                }
+            }
+            return legs;
+        };
+        const std::vector<Leg> heads = collect_legs(from_shard, shards_[from_shard].exit_stops, from, true);
+        const std::vector<Leg> tails = collect_legs(to_shard, shards_[to_shard].entry_stops, to, false);
+
+        if (auto overlay = SearchOverlay(heads, tails, best_time)) {
+            const auto& [route, head, tail] = *overlay;
+            transport_router::EdgeDescriptions result = heads[head].route;
+            AppendOverlayRoute(route, result);
+            result.insert(result.end(), tails[tail].route.begin(), tails[tail].route.end());
+            return result;
+        }
+        return best;
+    }
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include "router.h"
+#include "graph.h"
+
+namespace sharded_router {
+
+    constexpr size_t NO_SHARD = std::numeric_limits<size_t>::max();
+
+    /**
+     * Экспериментальный прототип: маршрутизатор поверх справочника, разбитого на географические шарды
+     * внутри одного процесса. Проверяет разложение на шарды и надстройку; отдельных процессов шардов,
+     * их файлов и протокола запросов к надстройке нет.
+     *
+     * Остановки с маршрутами делятся на полосы по долготе с равным числом остановок.
+     * У каждого шарда свой справочник и свой TransportRouter: в справочник шарда попадают его остановки,
+     * маршруты целиком внутри шарда и куски межшардовых маршрутов, не выходящие из шарда.
+     * Все шарды строятся и отвечают в одном процессе, а их справочники — копии частей исходного,
+     * который живёт рядом с ними, поэтому памяти нужно больше, чем без шардирования.
+     *
+     * Межшардовые пути идут через граф-надстройку (overlay). Её рёбра проезда — только поездки
+     * по межшардовым маршрутам, которые выходят из шарда остановки посадки; поездки внутри шарда
+     * покрывают куски маршрутов в справочниках шардов. Остановки посадки на такие поездки — выходы шарда,
+     * остановки прибытия — входы. Рёбра-сокращения идут от каждого входа к каждому выходу того же шарда
+     * с весом кратчайшего пути внутри шарда: любой путь между шардами состоит из поездок надстройки
+     * и отрезков внутри одного шарда от входа (или from) до выхода (или до to).
+     *
+     * Маршрут from -> to — лучший из пути внутри общего шарда (если шард один) и пути, найденного одним
+     * поиском Дейкстры по надстройке сразу от всех выходов шарда from (со временем пути до них от from)
+     * до всех входов шарда to (с временем пути от них до to).
+     */
+    class ShardedRouter {
+    public:
+        // catalogue должен пережить маршрутизатор
+        ShardedRouter(transport_router::RoutingSettings settings,
+                      const transport_catalogue::TransportCatalogue& catalogue,
+                      size_t shard_count);
+
+        std::optional<transport_router::EdgeDescriptions> BuildRoute(std::string_view stop_from, std::string_view stop_to) const;
+
+        size_t GetShardCount() const;
+        // Номер шарда остановки или NO_SHARD, если через неё не проходит ни один маршрут
+        size_t GetShardOf(const domain::Stop* stop) const;
+        size_t GetBoundaryStopCount() const;
+
+    private:
+        struct Shard {
+            std::unique_ptr<transport_router::TransportRouter> router;
+            // Имя маршрута в справочнике шарда -> имя маршрута в исходном справочнике
+            std::map<std::string, std::string_view, std::less<>> bus_names;
+            std::vector<const domain::Stop*> entry_stops; // Остановки прибытия поездок надстройки
+            std::vector<const domain::Stop*> exit_stops;  // Остановки посадки на поездки надстройки
+        };
+
+        // Время пути до граничной остановки (или от неё) внутри шарда и сам путь
+        struct Leg {
+            const domain::Stop* boundary;
+            transport_router::EdgeDescriptions route;
+            double time;
+        };
+
+        struct OverlayEdge {
+            transport_router::EdgeDescription description; // Для ожидания и проезда
+            const domain::Stop* from = nullptr;           // Для сокращения: граничные остановки одного шарда
+            const domain::Stop* to = nullptr;
+            bool shortcut = false;
+        };
+
+        void SplitIntoShards(size_t shard_count);
+        void BuildShards();
+        void BuildOverlay();
+        std::optional<transport_router::EdgeDescriptions> BuildShardRoute(size_t shard,
+                const domain::Stop* from, const domain::Stop* to) const;
+        // Маршруты внутри шарда одной пачкой (см. TransportRouter::BuildRoutes), в порядке queries
+        std::vector<std::optional<transport_router::EdgeDescriptions>> BuildShardRoutes(size_t shard,
+                const std::vector<std::pair<const domain::Stop*, const domain::Stop*>>& queries) const;
+        void TranslateShardRoute(size_t shard, transport_router::EdgeDescriptions& route) const;
+        // Дейкстра по надстройке от всех heads до всех tails: лучший путь и индексы его head и tail
+        std::optional<std::tuple<transport_router::RouterBase::RouteInfo, size_t, size_t>> SearchOverlay(
+                const std::vector<Leg>& heads, const std::vector<Leg>& tails, double time_limit) const;
+        void AppendOverlayRoute(const transport_router::RouterBase::RouteInfo& route, transport_router::EdgeDescriptions& result) const;
+
+        transport_router::RoutingSettings routing_settings_;
+        const transport_catalogue::TransportCatalogue& catalogue_;
+        std::vector<size_t> stop_shard_;             // По id остановки
+        std::vector<bool> cross_shard_bus_;          // По id маршрута
+        std::vector<Shard> shards_;
+        std::vector<graph::VertexId> overlay_vertex_; // По id остановки: вершина ожидания в надстройке или NO_VERTEX
+        std::unique_ptr<transport_router::Graph> overlay_graph_;
+        std::vector<OverlayEdge> overlay_edges_;      // По id ребра надстройки
+    };
+
+}
@@ -0,0 +1,58 @@
+#include "sorted_set.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sorted_set {
+
+    void IntersectScalar(std::span<const uint32_t> lhs, std::span<const uint32_t> rhs, std::vector<uint32_t>& out) {
+        size_t i = 0;
+        size_t j = 0;
+        while (i < lhs.size() && j < rhs.size()) {
+            if (lhs[i] < rhs[j]) {
+                ++i;
+            } else if (rhs[j] < lhs[i]) {
+                ++j;
+            } else {
+                out.push_back(lhs[i]);
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+    void Intersect(std::span<const uint32_t> lhs, std::span<const uint32_t> rhs, std::vector<uint32_t>& out) {
+        size_t i = 0;
+        size_t j = 0;
+#ifdef __SSE2__
+        // Каждый блок lhs сравнивается со всеми четырьмя циклическими сдвигами блока rhs,
+        // затем сдвигается тот блок (или оба), у которого последний элемент меньше
+        while (i + 4 <= lhs.size() && j + 4 <= rhs.size()) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs.data() + i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs.data() + j));
+            const __m128i eq = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi32(a, b),
+                                 _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)))),
+                    _mm_or_si128(_mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))),
+                                 _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3)))));
+            const int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+            for (size_t k = 0; k < 4; ++k) {
+                if (mask & (1 << k)) {
+                    out.push_back(lhs[i + k]);
+                }
+            }
+            const uint32_t lhs_last = lhs[i + 3];
+            const uint32_t rhs_last = rhs[j + 3];
+            if (lhs_last <= rhs_last) {
+                i += 4;
+            }
+            if (rhs_last <= lhs_last) {
+                j += 4;
+            }
+        }
+#endif
+        IntersectScalar(lhs.subspan(i), rhs.subspan(j), out);
+    }
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace sorted_set {
+
+    /**
+     * Пересечение двух строго возрастающих массивов, результат дописывается в out по возрастанию.
+     * При наличии SSE2 сравнивает блоки 4x4 за четыре векторные операции,
+     * хвосты и сборки без SSE2 обрабатываются обычным слиянием.
+     */
+    void Intersect(std::span<const uint32_t> lhs, std::span<const uint32_t> rhs, std::vector<uint32_t>& out);
+
+    // Скалярный вариант, используется для хвостов и для проверки векторного
+    void IntersectScalar(std::span<const uint32_t> lhs, std::span<const uint32_t> rhs, std::vector<uint32_t>& out);
+
+}
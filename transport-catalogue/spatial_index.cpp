@@ -0,0 +1,159 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace spatial_index {
+
+    namespace {
+        using geo::DEG_TO_RAD;
+        constexpr double METERS_PER_DEGREE = geo::radius_earth * DEG_TO_RAD;
+        constexpr size_t STOPS_PER_CELL = 2;
+        constexpr size_t MAX_CELLS_PER_SIDE = 4096;
+        // Запас при отборе по косинусу: погрешность скалярного произведения единичных векторов
+        // на порядки меньше, поэтому настоящие попадания не отбрасываются
+        constexpr double COSINE_MARGIN = 1e-12;
+        // Запас границ поиска для приближённого расстояния, которое может быть меньше точного
+        constexpr double APPROXIMATION_MARGIN = 0.01;
+    }
+
+    void StopGrid::Clear() {
+        rows_ = cols_ = 0;
+        cell_offsets_.clear();
+        entries_.clear();
+        batch_.Clear();
+    }
+
+    bool StopGrid::Empty() const {
+        return entries_.empty();
+    }
+
+    size_t StopGrid::CellIndex(size_t row, size_t col) const {
+        return row * cols_ + col;
+    }
+
+    size_t StopGrid::RowOf(double lat) const {
+        const double row = std::floor((lat - min_lat_) / cell_lat_);
+        return static_cast<size_t>(std::clamp(row, 0.0, static_cast<double>(rows_ - 1)));
+    }
+
+    size_t StopGrid::ColOf(double lng) const {
+        const double col = std::floor((lng - min_lng_) / cell_lng_);
+        return static_cast<size_t>(std::clamp(col, 0.0, static_cast<double>(cols_ - 1)));
+    }
+
+    void StopGrid::Build(const std::vector<const domain::Stop*>& stops) {
+        Clear();
+
+        std::vector<const domain::Stop*> valid;
+        valid.reserve(stops.size());
+        for (const domain::Stop* stop : stops) {
+            // Остановки с нераспознанными координатами (NaN) в индекс не попадают
+            if (std::isfinite(stop->coordinates.lat) && std::isfinite(stop->coordinates.lng)) {
+                valid.push_back(stop);
+            }
+        }
+        if (valid.empty()) {
+            return;
+        }
+
+        const auto [bottom_it, top_it] = std::minmax_element(valid.begin(), valid.end(),
+                [](const domain::Stop* lhs, const domain::Stop* rhs) { return lhs->coordinates.lat < rhs->coordinates.lat; });
+        const auto [left_it, right_it] = std::minmax_element(valid.begin(), valid.end(),
+                [](const domain::Stop* lhs, const domain::Stop* rhs) { return lhs->coordinates.lng < rhs->coordinates.lng; });
+        min_lat_ = (*bottom_it)->coordinates.lat;
+        min_lng_ = (*left_it)->coordinates.lng;
+        const double span_lat = (*top_it)->coordinates.lat - min_lat_;
+        const double span_lng = (*right_it)->coordinates.lng - min_lng_;
+
+        // Подбираем квадратную в метрах ячейку так, чтобы в среднем на неё приходилось STOPS_PER_CELL остановок
+        const double mid_lat = min_lat_ + span_lat / 2;
+        const double height = span_lat * METERS_PER_DEGREE;
+        const double width = span_lng * METERS_PER_DEGREE * std::cos(mid_lat * DEG_TO_RAD);
+        const double cells = std::max<double>(1.0, static_cast<double>(valid.size() / STOPS_PER_CELL));
+        const double side = std::sqrt(std::max(height * width, 1.0) / cells);
+        rows_ = std::clamp<size_t>(static_cast<size_t>(std::ceil(height / side)), 1, MAX_CELLS_PER_SIDE);
+        cols_ = std::clamp<size_t>(static_cast<size_t>(std::ceil(width / side)), 1, MAX_CELLS_PER_SIDE);
+        cell_lat_ = span_lat > 0 ? span_lat / rows_ : 1.0;
+        cell_lng_ = span_lng > 0 ? span_lng / cols_ : 1.0;
+
+        // Первый проход: считаем остановки в ячейках, второй: раскладываем их по местам
+        std::vector<size_t> cell_of(valid.size());
+        cell_offsets_.assign(rows_ * cols_ + 1, 0);
+        for (size_t i = 0; i < valid.size(); ++i) {
+            cell_of[i] = CellIndex(RowOf(valid[i]->coordinates.lat), ColOf(valid[i]->coordinates.lng));
+            ++cell_offsets_[cell_of[i] + 1];
+        }
+        for (size_t cell = 1; cell < cell_offsets_.size(); ++cell) {
+            cell_offsets_[cell] += cell_offsets_[cell - 1];
+        }
+        entries_.resize(valid.size());
+        std::vector<uint32_t> fill(cell_offsets_.begin(), cell_offsets_.end() - 1);
+        for (size_t i = 0; i < valid.size(); ++i) {
+            entries_[fill[cell_of[i]]++] = valid[i];
+        }
+        batch_.Reserve(entries_.size());
+        for (const domain::Stop* stop : entries_) {
+            batch_.Add(stop->coordinates);
+        }
+    }
+
+    std::vector<domain::NearbyStop> StopGrid::FindNearby(const geo::Coordinates& center, double radius, size_t limit,
+                                                         geo::DistanceMode mode) const {
+        std::vector<domain::NearbyStop> result;
+        if (entries_.empty() || limit == 0 || !(radius >= 0)) {
+            return result;
+        }
+
+        // Границы поиска: для точек в пределах угла theta от центра
+        // |dlat| <= theta, |dlng| <= asin(sin(theta) / cos(lat))
+        const bool precise = mode == geo::DistanceMode::PRECISE;
+        const double theta = (precise ? radius : radius * (1 + APPROXIMATION_MARGIN)) / geo::radius_earth;
+        const double delta_lat = theta / DEG_TO_RAD;
+        size_t col_first = 0;
+        size_t col_last = cols_ - 1;
+        const double cos_lat = std::cos(center.lat * DEG_TO_RAD);
+        if (theta < 3.1415926535 / 2 && std::sin(theta) < cos_lat) {
+            const double delta_lng = std::asin(std::sin(theta) / cos_lat) / DEG_TO_RAD;
+            col_first = ColOf(center.lng - delta_lng);
+            col_last = ColOf(center.lng + delta_lng);
+        }
+        const size_t row_first = RowOf(center.lat - delta_lat);
+        const size_t row_last = RowOf(center.lat + delta_lat);
+
+        // В точном режиме сначала пакетом отбираем кандидатов по косинусу центрального угла,
+        // точное расстояние считаем только для них. Приближённое расстояние дешевле самого отбора.
+        const double min_cosine = theta < 3.1415926535 ? geo::CosineOfDistance(radius) - COSINE_MARGIN : -2.0;
+        std::vector<double> cosines;
+        for (size_t row = row_first; row <= row_last; ++row) {
+            const uint32_t begin = cell_offsets_[CellIndex(row, col_first)];
+            const uint32_t end = cell_offsets_[CellIndex(row, col_last) + 1];
+            if (precise) {
+                cosines.resize(end - begin);
+                batch_.ComputeCosines(center, begin, cosines);
+            }
+            for (uint32_t i = begin; i < end; ++i) {
+                if (precise && cosines[i - begin] < min_cosine) {
+                    continue;
+                }
+                const double distance = geo::ComputeDistance(center, entries_[i]->coordinates, mode);
+                if (distance <= radius) {
+                    result.push_back({entries_[i], distance});
+                }
+            }
+        }
+
+        const auto less = [](const domain::NearbyStop& lhs, const domain::NearbyStop& rhs) {
+            return lhs.distance < rhs.distance
+                    || (lhs.distance == rhs.distance && lhs.stop->name < rhs.stop->name);
+        };
+        if (limit < result.size()) {
+            std::partial_sort(result.begin(), result.begin() + limit, result.end(), less);
+            result.resize(limit);
+        } else {
+            std::sort(result.begin(), result.end(), less);
+        }
+        return result;
+    }
+
+}
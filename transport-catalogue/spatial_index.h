@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "geo.h"
+#include "domain.h"
+
+namespace spatial_index {
+
+    /**
+     * Равномерная сетка по географическим координатам остановок.
+     * Строится один раз после загрузки справочника, ячейки хранятся в CSR-виде:
+     * смещения ячеек + плотный массив остановок, отсортированный по номеру ячейки.
+     */
+    class StopGrid {
+    public:
+        StopGrid() = default;
+
+        void Build(const std::vector<const domain::Stop*>& stops);
+        void Clear();
+        bool Empty() const;
+
+        /**
+         * Возвращает не более limit остановок в радиусе radius метров от точки center,
+         * отсортированных по возрастанию расстояния geo::ComputeDistance в режиме mode.
+         */
+        std::vector<domain::NearbyStop> FindNearby(const geo::Coordinates& center, double radius, size_t limit,
+                                                   geo::DistanceMode mode = geo::DistanceMode::PRECISE) const;
+
+    private:
+        size_t CellIndex(size_t row, size_t col) const;
+        size_t RowOf(double lat) const;
+        size_t ColOf(double lng) const;
+
+        double min_lat_ = 0.0;
+        double min_lng_ = 0.0;
+        double cell_lat_ = 1.0;  // Размер ячейки по широте в градусах
+        double cell_lng_ = 1.0;  // Размер ячейки по долготе в градусах
+        size_t rows_ = 0;
+        size_t cols_ = 0;
+        std::vector<uint32_t> cell_offsets_;     // rows_ * cols_ + 1 смещений в entries_
+        std::vector<const domain::Stop*> entries_;
+        geo::CoordinatesBatch batch_;            // Единичные векторы остановок в порядке entries_
+    };
+
+}
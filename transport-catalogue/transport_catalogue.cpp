@@ -4,18 +4,71 @@ using namespace std::literals;
 
 namespace transport_catalogue {
 
+    TransportCatalogue::TransportCatalogue()
+        : TransportCatalogue(std::make_shared<std::pmr::monotonic_buffer_resource>()) {
+    }
+
+    TransportCatalogue::TransportCatalogue(std::pmr::memory_resource* resource)
+        : resource_(resource),
+          buses_(resource),
+          stops_(resource),
+          stop_trig_(resource),
+          busname_to_bus_(resource),
+          stopname_to_stop_(resource),
+          buses_stop_at_stops_(resource),
+          distance_between_stops_from_route_(resource),
+          stop_bus_ids_(resource) {
+    }
+
+    TransportCatalogue::TransportCatalogue(std::shared_ptr<std::pmr::memory_resource> arena)
+        : TransportCatalogue(arena.get()) {
+        arena_ = std::move(arena);
+    }
+
+    TransportCatalogue::TransportCatalogue(const TransportCatalogue& other)
+        : TransportCatalogue() {
+        for (const domain::Stop& stop : other.stops_) {
+            AddStop(stop);
+        }
+        for (const auto& [stops_pair, distance] : other.distance_between_stops_from_route_) {
+            if (stops_pair.first != nullptr && stops_pair.second != nullptr) {
+                SetDistanceBetweenStop(stops_pair.second->name, FindStop(stops_pair.first->name), distance);
+            }
+        }
+        for (const domain::Bus& bus : other.buses_) {
+            std::vector<std::string_view> stops;
+            stops.reserve(bus.stop.size());
+            for (const domain::Stop* stop : bus.stop) {
+                stops.push_back(stop->name);
+            }
+            AddBus(bus.name, stops, bus.ring_route);
+        }
+        if (other.frozen_) {
+            Freeze();
+        }
+    }
+
+    std::pmr::memory_resource* TransportCatalogue::GetMemoryResource() const {
+        return resource_;
+    }
+
     // Если остановки такой не было словаре тогда добавляем
     void TransportCatalogue::AddStop(const domain::Stop &stop) {
 
         // Если имя остановки не заполнено тогда не нужно добавлять в список.
-        if (stop.name == ""s) {
+        if (stop.name.empty()) {
             return;
         }
 
         auto it = stopname_to_stop_.find(stop.name);
         if (it == stopname_to_stop_.end()) {
-            stops_.push_back(std::move(stop));
+            // Имя копируется в арену справочника, а не в кучу
+            stops_.emplace_back(stop.name, stop.coordinates, resource_);
+            stops_.back().id = stops_.size() - 1;
+            stop_trig_.push_back(geo::Precompute(stops_.back().coordinates));
             stopname_to_stop_[stops_.back().name] = &stops_.back();
+            frozen_ = false;
+            name_index_ready_ = false;
         }
 
     }
@@ -26,7 +79,12 @@ namespace transport_catalogue {
             return nullptr;
         }
 
-        auto it = stopname_to_stop_.find(std::string{stop_name}); // @suppress("Symbol is not resolved")
+        if (name_index_ready_) {
+            auto found = stop_name_index_.Find(stop_name);
+            return found ? *found : nullptr;
+        }
+
+        auto it = stopname_to_stop_.find(stop_name);
         if (it != stopname_to_stop_.end()) {
             return it->second;
         }
@@ -34,7 +92,7 @@ namespace transport_catalogue {
         return nullptr;
     }
 
-    void TransportCatalogue::AddBus(std::string bus_name,
+    void TransportCatalogue::AddBus(std::string_view bus_name,
                                     const std::vector<std::string_view> stops,
                                     bool ring_route) {
 
@@ -48,34 +106,35 @@ namespace transport_catalogue {
             return;
         }
 
-        domain::Bus bus;
+        domain::Bus bus(resource_);
         bus.name = bus_name;
-        const domain::Stop* stp;
-
-        std::unordered_map<std::string_view, const domain::Stop*, HasherStopBus> unique_stops; // @suppress("Invalid template argument")
+        bus.stop.reserve(stops.size());
 
         for(const std::string_view& stop_str: stops){
-            stp = FindStop(stop_str);
+            const domain::Stop* stp = FindStop(stop_str);
             if(stp == nullptr) {
                 return; // Остановка не найдена прекращаем выполнение процедуры
             }
-
             bus.stop.push_back(stp);
-
-            unique_stops[stop_str] = stp;
-            // Добавляем в словарь остановок информацию о автобусе
-            auto& v_str = buses_stop_at_stops_[stp->name];
-            auto it = v_str.find(bus_name);
-            if (it == v_str.end()){
-               v_str.insert(bus.name);
-            }
         }
 
-        bus.unique_stops_count = unique_stops.size(); // Количество уникальных остновок
+        std::vector<const domain::Stop*> unique_stops(bus.stop.begin(), bus.stop.end());
+        std::sort(unique_stops.begin(), unique_stops.end());
+        bus.unique_stops_count = std::unique(unique_stops.begin(), unique_stops.end()) - unique_stops.begin(); // Количество уникальных остновок
         bus.ring_route = ring_route; // Колцевой маршрут
-        UpdateDistanceBetweenStops(bus);
+        UpdateDistancePrefixSums(bus);
+        bus.id = buses_.size();
         buses_.push_back(std::move(bus));
-        busname_to_bus_[buses_.back().name] = &buses_.back();
+        const domain::Bus& added = buses_.back();
+        busname_to_bus_[added.name] = &buses_.back();
+
+        // Добавляем в словарь остановок информацию о автобусе, когда он уже лежит в хранилище.
+        // Порядок обхода — порядок маршрута: от него зависит нумерация вершин графа маршрутизации.
+        for (const domain::Stop* stp : added.stop) {
+            buses_stop_at_stops_[stp->name].insert(added.name);
+        }
+        frozen_ = false;
+        name_index_ready_ = false;
 
     }
 
@@ -85,16 +144,16 @@ namespace transport_catalogue {
               return bus_info;
         }
 
-        auto it = busname_to_bus_.find(bus_name);
-        if (it == busname_to_bus_.end()) {
+        const domain::Bus* bus = FindBus(bus_name);
+        if (bus == nullptr) {
               return bus_info;
         }
 
         bus_info.found = true;
-        bus_info.unique_stops_count = it->second->unique_stops_count;
-        bus_info.no_unique_stops_count = it->second->stop.size();
-        bus_info.route_length = GetRouteLengthForBus(it->second);
-        bus_info.curvature = bus_info.route_length / GetRouteLengthGeographicalCoordinatesForBus(it->second);
+        bus_info.unique_stops_count = bus->unique_stops_count;
+        bus_info.no_unique_stops_count = domain::RouteView(*bus).size();
+        bus_info.route_length = GetRouteLengthForBus(bus);
+        bus_info.curvature = bus_info.route_length / GetRouteLengthGeographicalCoordinatesForBus(bus);
         return bus_info;
     }
 
@@ -104,15 +163,20 @@ namespace transport_catalogue {
               std::set<std::string> tmp;
               return tmp;
         }
-        return it->second;
+        return {it->second.begin(), it->second.end()};
     }
 
-    const domain::Bus* TransportCatalogue::FindBus(std::string bus_name) const {
+    const domain::Bus* TransportCatalogue::FindBus(std::string_view bus_name) const {
 
         if (bus_name == ""s) {
             return nullptr;
         }
 
+        if (name_index_ready_) {
+            auto found = bus_name_index_.Find(bus_name);
+            return found ? *found : nullptr;
+        }
+
         auto it = busname_to_bus_.find(bus_name);
         if (it != busname_to_bus_.end()) {
             return it->second;
@@ -129,19 +193,19 @@ namespace transport_catalogue {
         return busname_to_bus_.size();
     }
 
-    void TransportCatalogue::UpdateDistanceBetweenStops(const domain::Bus &bus){
-        auto it = bus.stop.begin();
-        const auto &end = bus.stop.end();
-        std::pair<const domain::Stop*,const domain::Stop*>dist;
-        while(it != end){
-            if(std::next(it) != end){ // @suppress("Invalid arguments")
-               dist = {*it,*std::next(it)}; // @suppress("Invalid arguments")
-               auto find_dist = distance_between_stops_geographical_coordinates_.find(dist);
-               if(find_dist == distance_between_stops_geographical_coordinates_.end()){
-                   distance_between_stops_geographical_coordinates_[dist] = ComputeDistance(dist.first->coordinates,dist.second->coordinates);
-               }
-            }
-            ++it;
+    // Заполняет накопленные суммы расстояний по маршруту, после чего длина любого
+    // участка маршрута считается как разность двух элементов без обращений к хеш-таблицам
+    void TransportCatalogue::UpdateDistancePrefixSums(domain::Bus &bus) const {
+        const size_t size = bus.stop.size();
+        bus.road_distance_forward.assign(size, 0);
+        bus.road_distance_backward.assign(size, 0);
+        bus.geo_distance.assign(size, 0.0);
+        for (size_t i = 1; i < size; ++i) {
+            const domain::Stop* prev = bus.stop[i - 1];
+            const domain::Stop* cur = bus.stop[i];
+            bus.road_distance_forward[i] = bus.road_distance_forward[i - 1] + GetDistanceBetweenStops(prev, cur);
+            bus.road_distance_backward[i] = bus.road_distance_backward[i - 1] + GetDistanceBetweenStops(cur, prev);
+            bus.geo_distance[i] = bus.geo_distance[i - 1] + geo::ComputeDistance(stop_trig_[prev->id], stop_trig_[cur->id]);
         }
     }
 
@@ -150,81 +214,59 @@ namespace transport_catalogue {
         const auto stp_to = FindStop(stp_to_sv);
       //  std::cerr << "to " << stp_to->name << " from " << stp_from->name << " dist " << distance << std::endl;
         distance_between_stops_from_route_[{stp_from, stp_to}] = distance;
-        distance_between_stops_[{stp_to, stp_from}] = distance;
+        frozen_ = false;
 
     }
 
 
-    uint32_t TransportCatalogue::GetDistanceBetweenStops (
-            std::pair<const domain::Stop*, const domain::Stop*> &dist) const{
-        auto find_dist = distance_between_stops_.find(dist);
-        if (find_dist != distance_between_stops_.end()) {
-            auto dist = *find_dist;
-            return dist.second;
+    uint32_t TransportCatalogue::GetDistanceBetweenStops(const domain::Stop* stop_1, const domain::Stop* stop_2) const {
+        auto it = distance_between_stops_from_route_.find({stop_1, stop_2});
+        if (it != distance_between_stops_from_route_.end()) {
+            return it->second;
+        }
+        it = distance_between_stops_from_route_.find({stop_2, stop_1});
+        if (it != distance_between_stops_from_route_.end()) {
+            return it->second;
         }
         return 0;
     }
 
-    uint32_t TransportCatalogue::GetDistanceBetweenStops(const domain::Stop* stop_1, const domain::Stop* stop_2) const {
-         if (distance_between_stops_from_route_.count({stop_1, stop_2}) > 0) {
-             return distance_between_stops_from_route_.at({stop_1, stop_2});
-         } else if (distance_between_stops_from_route_.count({stop_2, stop_1})) {
-             return distance_between_stops_from_route_.at({stop_2, stop_1});
-         } else {
-             return 0;
-         }
-     }
+    // Расстояние от начала полного маршрута до позиции index. Для некольцевого маршрута
+    // обратный путь хранится не копией остановок, а суммами road_distance_backward.
+    uint32_t TransportCatalogue::GetRoadDistanceToPosition(const domain::Bus& bus, size_t index) const {
+        const size_t stored = bus.stop.size();
+        if (index < stored) {
+            return bus.road_distance_forward.at(index);
+        }
+        const size_t last = stored - 1;
+        return bus.road_distance_forward.at(last) + bus.road_distance_backward.at(last)
+                - bus.road_distance_backward.at(2 * last - index);
+    }
 
-    double TransportCatalogue::GetRouteLengthForBus(const domain::Bus *bus) const {
-        uint32_t result = 0;
-
-        auto it = bus->stop.begin();
-        const auto &end = bus->stop.end();
-        std::pair<const domain::Stop*, const domain::Stop*> dist;
-        try {
-            while (it != end) {
-                if (std::next(it) != end) { // @suppress("Invalid arguments")
-                    dist = { *std::next(it), *it }; // @suppress("Invalid arguments")
-                    uint32_t tmp = GetDistanceBetweenStops(dist);
-                    if (tmp == 0) {
-                        dist = { *it, *std::next(it) }; // @suppress("Invalid arguments")
-                        result += GetDistanceBetweenStops(dist);
-                    } else
-                        result += tmp;
-                }
-                ++it;
-            }
-        } catch (...) {
+    uint32_t TransportCatalogue::GetRoadDistanceOnBus(const domain::Bus& bus, size_t from_index, size_t to_index) const {
+        if (from_index >= to_index) {
             return 0;
         }
+        return GetRoadDistanceToPosition(bus, to_index) - GetRoadDistanceToPosition(bus, from_index);
+    }
 
-        return result;
+    double TransportCatalogue::GetRouteLengthForBus(const domain::Bus *bus) const {
+        const size_t size = domain::RouteView(*bus).size();
+        return size == 0 ? 0.0 : GetRoadDistanceToPosition(*bus, size - 1);
     }
 
     double TransportCatalogue::GetRouteLengthGeographicalCoordinatesForBus(const domain::Bus* bus) const {
-        double result = 0;
-        auto it = bus->stop.begin();
-        const auto &end = bus->stop.end();
-        std::pair<const domain::Stop*, const domain::Stop*>dist;
-        try{
-            while(it != end){
-                if(std::next(it) != end){ // @suppress("Invalid arguments")
-                   dist = {*it,*std::next(it)}; // @suppress("Invalid arguments")
-                   auto find_dist = distance_between_stops_geographical_coordinates_.find(dist);
-                   if(find_dist != distance_between_stops_geographical_coordinates_.end()){
-                       auto dist = *find_dist;
-                       result += dist.second; // @suppress("Field cannot be resolved")
-                   }
-                }
-                ++it;
-            }
-        } catch (...){
+        if (bus->geo_distance.empty()) {
             return 0.0;
         }
-        return result;
+        // Географическое расстояние симметрично, обратный путь равен прямому
+        return bus->ring_route ? bus->geo_distance.back() : 2 * bus->geo_distance.back();
     }
 
     bool TransportCatalogue::StopExists(std::string_view stp_name) const{
+        if (name_index_ready_) {
+            return stop_name_index_.Find(stp_name) != nullptr;
+        }
         auto it = stopname_to_stop_.find(stp_name);
         return !(it == stopname_to_stop_.end());
     }
@@ -241,18 +283,13 @@ namespace transport_catalogue {
         domain::RouteInfo result;
         for(const auto &bus_name :buses_names){
             domain::BusInfoMap bus_info_item;
-            const domain::Bus* bus = FindBus(std::string{bus_name}); // @suppress("Symbol is not resolved")
-            auto it = bus->stop.begin();
-            const auto &end = bus->stop.end();
-                std::vector<geo::Coordinates> coord;
-                while (it != end) {
-                    auto res = *it;
+            const domain::Bus* bus = FindBus(bus_name);
+                for (const domain::Stop* res : domain::RouteView(*bus)) {
                     domain::StopInfoMap stp;
                     stp.coor = res->coordinates;
 
-                    bus_info_item.coor.push_back(res->coordinates); // @suppress("Field cannot be resolved") // @suppress("Invalid arguments")
+                    bus_info_item.coor.push_back(stp.coor); // @suppress("Field cannot be resolved") // @suppress("Invalid arguments")
                     result.stop_info.insert({res->name, stp});
-                    ++it;
                 }
                 bus_info_item.ring_route = bus->ring_route;
                 result.bus_info.insert({bus_name,std::move(bus_info_item)});
@@ -260,6 +297,10 @@ namespace transport_catalogue {
        return std::make_unique<domain::RouteInfo>(result);
     }
 
+    size_t TransportCatalogue::GetStopCount() const {
+        return stops_.size();
+    }
+
     size_t TransportCatalogue::GetAmountOfUsedStops() const {
         return buses_stop_at_stops_.size();
     }
@@ -273,7 +314,102 @@ namespace transport_catalogue {
         return used_stops_cash;
     }
 
-    const std::unordered_map<std::string_view, domain::Bus*, HasherStopBus>& TransportCatalogue::GetBusIndexes() const {
+    const std::pmr::deque<domain::Stop>& TransportCatalogue::GetAllStops() const {
+        return stops_;
+    }
+
+    const std::pmr::deque<domain::Bus>& TransportCatalogue::GetAllBuses() const {
+        return buses_;
+    }
+
+    const DistanceMap& TransportCatalogue::GetDistances() const {
+        return distance_between_stops_from_route_;
+    }
+
+    void TransportCatalogue::Freeze() {
+        std::vector<const domain::Stop*> stops;
+        stops.reserve(stops_.size());
+        for (const domain::Stop& stop : stops_) {
+            stops.push_back(&stop);
+        }
+        stop_grid_.Build(stops);
+        // Расстояния могли быть заданы уже после добавления маршрутов
+        for (domain::Bus& bus : buses_) {
+            UpdateDistancePrefixSums(bus);
+        }
+        stop_bus_ids_.clear();
+        stop_bus_ids_.resize(stops_.size());
+        for (const domain::Stop& stop : stops_) {
+            const std::vector<uint32_t> ids = CollectStopBusIds(&stop);
+            stop_bus_ids_[stop.id].assign(ids.begin(), ids.end());
+        }
+        name_index_ready_ = stop_name_index_.Build({stopname_to_stop_.begin(), stopname_to_stop_.end()})
+                && bus_name_index_.Build({busname_to_bus_.begin(), busname_to_bus_.end()});
+        frozen_ = true;
+    }
+
+    std::vector<domain::NearbyStop> TransportCatalogue::FindNearbyStops(const geo::Coordinates& center, double radius, size_t limit,
+                                                                        geo::DistanceMode mode) const {
+        if (frozen_) {
+            return stop_grid_.FindNearby(center, radius, limit, mode);
+        }
+        // Справочник ещё не заморожен: строим временную сетку, что равносильно линейному проходу
+        std::vector<const domain::Stop*> stops;
+        for (const domain::Stop& stop : stops_) {
+            stops.push_back(&stop);
+        }
+        spatial_index::StopGrid grid;
+        grid.Build(stops);
+        return grid.FindNearby(center, radius, limit, mode);
+    }
+
+    std::vector<uint32_t> TransportCatalogue::CollectStopBusIds(const domain::Stop* stop) const {
+        std::vector<uint32_t> ids;
+        auto it = buses_stop_at_stops_.find(stop->name);
+        if (it == buses_stop_at_stops_.end()) {
+            return ids;
+        }
+        ids.reserve(it->second.size());
+        for (std::string_view bus_name : it->second) {
+            ids.push_back(static_cast<uint32_t>(FindBus(bus_name)->id));
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    /**
+     * Маршруты, на которых можно без пересадки доехать от from до to.
+     * Кандидаты — пересечение отсортированных списков маршрутов двух остановок,
+     * затем для каждого проверяется, что to встречается в полном маршруте после from.
+     */
+    std::vector<const domain::Bus*> TransportCatalogue::FindDirectBuses(const domain::Stop* from, const domain::Stop* to) const {
+        std::vector<const domain::Bus*> result;
+        if (from == nullptr || to == nullptr) {
+            return result;
+        }
+
+        std::vector<uint32_t> common;
+        if (frozen_) {
+            sorted_set::Intersect(stop_bus_ids_[from->id], stop_bus_ids_[to->id], common);
+        } else {
+            sorted_set::Intersect(CollectStopBusIds(from), CollectStopBusIds(to), common);
+        }
+
+        for (uint32_t id : common) {
+            const domain::Bus& bus = buses_[id];
+            const domain::RouteView route(bus);
+            auto it = std::find(route.begin(), route.end(), from);
+            if (it != route.end() && std::find(++it, route.end(), to) != route.end()) {
+                result.push_back(&bus);
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const domain::Bus* lhs, const domain::Bus* rhs) {
+            return lhs->name < rhs->name;
+        });
+        return result;
+    }
+
+    const BusIndex& TransportCatalogue::GetBusIndexes() const {
         return busname_to_bus_;
     }
 
@@ -2,11 +2,15 @@
 
 #include <algorithm>
 #include <deque>
+#include <memory_resource>
 #include <vector>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include "domain.h"
+#include "spatial_index.h"
+#include "perfect_hash.h"
+#include "sorted_set.h"
 #include <set>
 #include <map>
 #include <iostream>
@@ -28,24 +32,46 @@ namespace transport_catalogue{
 
     struct HasherDistanceBetweenStops {
         public:
+            // Хешируются адреса остановок: склеивание имён выделяло бы строку на каждый поиск
             size_t operator()(std::pair<const domain::Stop*, const domain::Stop*> key_bus) const {
-                return hasher_(key_bus.second->name + key_bus.first->name);
+                return hasher_(key_bus.first) * 37 + hasher_(key_bus.second);
             }
 
         private:
-            std::hash<std::string_view> hasher_;
+            std::hash<const domain::Stop*> hasher_;
         };
 
+    using BusIndex = std::pmr::unordered_map<std::string_view, domain::Bus*, HasherStopBus>;
+    using DistanceMap = std::pmr::unordered_map<std::pair<const domain::Stop*,const domain::Stop*>, uint32_t, HasherDistanceBetweenStops>;
+
     class TransportCatalogue {
 
     public:
 
-        TransportCatalogue() = default;
+        // Все контейнеры справочника размещаются в собственной монотонной арене:
+        // память отдаётся крупными блоками и освобождается целиком вместе со справочником
+        TransportCatalogue();
+        // Контейнеры размещаются в resource, который должен пережить справочник
+        explicit TransportCatalogue(std::pmr::memory_resource* resource);
+        // Копия заново собирается из данных other в собственной арене,
+        // так что её указатели ссылаются на её же остановки и маршруты
+        TransportCatalogue(const TransportCatalogue& other);
+        // Перемещение забирает контейнеры вместе с их ресурсом, указатели остаются верными
+        TransportCatalogue(TransportCatalogue&& other) = default;
+        // Присваивание между справочниками с разными ресурсами перемещало бы элементы поштучно
+        // и оставляло бы висячие указатели в индексах, поэтому оно запрещено
+        TransportCatalogue& operator=(const TransportCatalogue& other) = delete;
+        TransportCatalogue& operator=(TransportCatalogue&& other) = delete;
+
+        std::pmr::memory_resource* GetMemoryResource() const;
 
         void AddStop(const domain::Stop& stop);
         const domain::Stop* FindStop(std::string_view stop_name) const;
-        void AddBus(std::string bus_name, const std::vector<std::string_view> stop, bool ring_route = false);
-        const domain::Bus* FindBus(std::string bus_name) const;
+        // ring_route задаёт смысл stop, поэтому значения по умолчанию нет. Кольцевой маршрут (true) хранится как задан,
+        // последняя остановка повторяет первую. Некольцевой (false): stop — путь в одну сторону, обратный путь
+        // не дописывается, а выводится из него (domain::RouteView) и входит в длину и число остановок маршрута
+        void AddBus(std::string_view bus_name, const std::vector<std::string_view> stop, bool ring_route);
+        const domain::Bus* FindBus(std::string_view bus_name) const;
         domain::BusInfo GetBusInfo(const std::string_view& bus_name) const;
         const std::set<std::string> GetStopInfo(const std::string_view& stop_name) const;
         void SetDistanceBetweenStop(std::string_view stp_to, const domain::Stop* stp_from, uint32_t distance);
@@ -53,10 +79,27 @@ namespace transport_catalogue{
         BusesListPointer GetBuses() const;
         domain::StopCoordinatesListPointer GetCoordinatesStopBuses(std::set<std::string_view> buses_names) const;
 
-        const std::unordered_map<std::string_view, domain::Bus*, HasherStopBus>& GetBusIndexes() const;
+        const BusIndex& GetBusIndexes() const;
         size_t GetAmountOfUsedStops() const;
+        size_t GetStopCount() const;
         std::vector<std::string_view> GetUsedStopNames() const;
         uint32_t GetDistanceBetweenStops(const domain::Stop* stop_1, const domain::Stop* stop_2) const;
+        // Дорожное расстояние при проезде на автобусе bus от позиции from_index до позиции to_index
+        // полного маршрута (см. domain::RouteView), from_index <= to_index. Вычисляется как разность накопленных сумм.
+        uint32_t GetRoadDistanceOnBus(const domain::Bus& bus, size_t from_index, size_t to_index) const;
+
+        // Полное содержимое справочника в порядке добавления, используется при сериализации
+        const std::pmr::deque<domain::Stop>& GetAllStops() const;
+        const std::pmr::deque<domain::Bus>& GetAllBuses() const;
+        // Дорожные расстояния: {откуда, куда} -> метры
+        const DistanceMap& GetDistances() const;
+
+        // Строит индексы по загруженным данным, вызывается после заполнения справочника
+        void Freeze();
+        std::vector<domain::NearbyStop> FindNearbyStops(const geo::Coordinates& center, double radius, size_t limit,
+                                                        geo::DistanceMode mode = geo::DistanceMode::PRECISE) const;
+        // Маршруты без пересадки от остановки from до остановки to, по возрастанию имени
+        std::vector<const domain::Bus*> FindDirectBuses(const domain::Stop* from, const domain::Stop* to) const;
 
         // -- Методы используются для самописных юнит-тестов
         size_t NumberOfStops();
@@ -65,19 +108,30 @@ namespace transport_catalogue{
 
     private:
 
-        uint32_t GetDistanceBetweenStops(std::pair<const domain::Stop*, const domain::Stop*> &dist) const;
-        void UpdateDistanceBetweenStops(const domain::Bus &bus);
+        explicit TransportCatalogue(std::shared_ptr<std::pmr::memory_resource> arena);
+        void UpdateDistancePrefixSums(domain::Bus &bus) const;
+        uint32_t GetRoadDistanceToPosition(const domain::Bus& bus, size_t index) const;
+        std::vector<uint32_t> CollectStopBusIds(const domain::Stop* stop) const;
         double GetRouteLengthForBus(const domain::Bus* bus) const;
         double GetRouteLengthGeographicalCoordinatesForBus(const domain::Bus*) const;
 
-        std::deque<domain::Bus> buses_; // Хранилище аттрибутов всех автобусов
-        std::deque<domain::Stop> stops_; // Хранилище аттрибутов всех остановок
-        std::unordered_map<std::string_view, domain::Bus*, HasherStopBus> busname_to_bus_; // Список - имя автобуса : аттрибуты автобуса
-        std::unordered_map<std::string_view, domain::Stop*, HasherStopBus> stopname_to_stop_; // Список - имя остановки : аттрибуты остановки
-        std::unordered_map<std::string_view, std::set<std::string>, HasherStopBus> buses_stop_at_stops_; // Список - имя остановки : список имен автобусов проходящих через эту остановку
-        std::unordered_map<std::pair<const domain::Stop*,const domain::Stop*>, uint32_t, HasherDistanceBetweenStops> distance_between_stops_;
-        std::unordered_map<std::pair<const domain::Stop*,const domain::Stop*>, uint32_t, HasherDistanceBetweenStops> distance_between_stops_from_route_;
-        std::unordered_map<std::pair<const domain::Stop*,const domain::Stop*>, double, HasherDistanceBetweenStops> distance_between_stops_geographical_coordinates_;
+        std::shared_ptr<std::pmr::memory_resource> arena_; // Собственная арена, если ресурс не передан явно
+        std::pmr::memory_resource* resource_;
+        std::pmr::deque<domain::Bus> buses_; // Хранилище аттрибутов всех автобусов
+        std::pmr::deque<domain::Stop> stops_; // Хранилище аттрибутов всех остановок
+        std::pmr::vector<geo::PrecomputedCoordinates> stop_trig_; // По id остановки: синус и косинус широты для географических расстояний
+        BusIndex busname_to_bus_; // Список - имя автобуса : аттрибуты автобуса
+        std::pmr::unordered_map<std::string_view, domain::Stop*, HasherStopBus> stopname_to_stop_; // Список - имя остановки : аттрибуты остановки
+        // Список - имя остановки : имена автобусов проходящих через эту остановку (ссылаются на Bus::name в buses_)
+        std::pmr::unordered_map<std::string_view, std::pmr::set<std::string_view>, HasherStopBus> buses_stop_at_stops_;
+        DistanceMap distance_between_stops_from_route_;
+        spatial_index::StopGrid stop_grid_; // Сетка по координатам остановок, строится в Freeze()
+        // Совершенные хеши по именам, строятся в Freeze() и используются вместо unordered_map, пока справочник не меняется
+        perfect_hash::PerfectHashMap<domain::Stop*> stop_name_index_;
+        perfect_hash::PerfectHashMap<domain::Bus*> bus_name_index_;
+        std::pmr::vector<std::pmr::vector<uint32_t>> stop_bus_ids_; // Номер остановки -> отсортированные номера маршрутов, строится в Freeze()
+        bool name_index_ready_ = false;
+        bool frozen_ = false;
 
     };
 }
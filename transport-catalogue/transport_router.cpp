@@ -1,14 +1,173 @@
 #include "transport_router.h"
+#include "raptor_router.h"
+
+#include <unordered_map>
 
 namespace transport_router {
-    TransportRouter::TransportRouter(RoutingSettings settings, std::unique_ptr<transport_catalogue::TransportCatalogue> &&transport_catalogue)
+    namespace {
+        // Выходы из автобуса пропускаются, подряд идущие поездки (в модели ROUTE_LINES — по перегонам) склеиваются
+        void AppendItem(EdgeDescriptions& route, const EdgeDescription& item) {
+            if (item.type_ == EdgeType::ALIGHT) {
+                return;
+            }
+            if (item.type_ == EdgeType::BUS && !route.empty() && route.back().type_ == EdgeType::BUS
+                    && route.back().edge_name_ == item.edge_name_) {
+                route.back().time_ += item.time_;
+                route.back().span_count_ = *route.back().span_count_ + *item.span_count_;
+                return;
+            }
+            route.push_back(item);
+        }
+    }
+
+    std::unique_ptr<RouterBase> MakeRouter(RouterEngine engine, const Graph& graph) {
+        if (engine == RouterEngine::DIJKSTRA || engine == RouterEngine::A_STAR || engine == RouterEngine::RAPTOR) {
+            return std::make_unique<graph::DijkstraRouter<double>>(graph);
+        }
+        if (engine == RouterEngine::BIDIRECTIONAL_DIJKSTRA) {
+            return std::make_unique<graph::BidirectionalDijkstraRouter<double>>(graph);
+        }
+        if (engine == RouterEngine::CONTRACTION_HIERARCHIES) {
+            return std::make_unique<graph::ContractionHierarchyRouter<double>>(graph);
+        }
+        return std::make_unique<Router>(graph);
+    }
+
+    size_t GetGraphVertexCount(const transport_catalogue::TransportCatalogue& catalogue, GraphModel graph_model) {
+        if (graph_model == GraphModel::STOP_PAIRS) {
+            return catalogue.GetAmountOfUsedStops() * 2;
+        }
+        size_t vertex_count = catalogue.GetAmountOfUsedStops();
+        for (const auto& [name, bus_ptr] : catalogue.GetBusIndexes()) {
+            vertex_count += domain::RouteView(*bus_ptr).size();
+        }
+        return vertex_count;
+    }
+
+    TransportRouter::TransportRouter() = default;
+    TransportRouter::TransportRouter(TransportRouter&& other) noexcept = default;
+    TransportRouter& TransportRouter::operator=(TransportRouter&& other) noexcept = default;
+    TransportRouter::~TransportRouter() = default;
+
+    TransportRouter::TransportRouter(RoutingSettings settings, std::shared_ptr<const transport_catalogue::TransportCatalogue> transport_catalogue)
             : routing_settings_(settings),
               transport_catalogue_(std::move(transport_catalogue)),
-              graph_(std::make_unique<Graph>(transport_catalogue_->GetAmountOfUsedStops() * 2)),
               router_(nullptr)
     {
+        if (routing_settings_.route_cache_bytes_ > 0) {
+            route_cache_ = std::make_unique<RouteCache>(routing_settings_.route_cache_bytes_);
+        }
+        if (routing_settings_.router_engine_ == RouterEngine::RAPTOR) {
+            // Граф не строится: RAPTOR читает маршруты прямо из справочника
+            raptor_ = std::make_unique<raptor::RaptorRouter>(*transport_catalogue_, routing_settings_);
+            return;
+        }
         FillGraph();
-        router_ = std::make_unique<Router>(*graph_);
+        MakeEngine();
+    }
+
+    TransportRouter::TransportRouter(RoutingSettings settings, std::shared_ptr<const transport_catalogue::TransportCatalogue> transport_catalogue,
+                                     RouterState&& state)
+            : routing_settings_(settings),
+              transport_catalogue_(std::move(transport_catalogue))
+    {
+        if (routing_settings_.route_cache_bytes_ > 0) {
+            route_cache_ = std::make_unique<RouteCache>(routing_settings_.route_cache_bytes_);
+        }
+        if (routing_settings_.router_engine_ == RouterEngine::RAPTOR) {
+            raptor_ = std::make_unique<raptor::RaptorRouter>(*transport_catalogue_, routing_settings_);
+            return;
+        }
+        if (state.edges_descriptions.size() != state.edges.size()
+                || state.vertex_count != GetGraphVertexCount(*transport_catalogue_, routing_settings_.graph_model_)
+                || state.vertex_stops.size() != state.vertex_count
+                || state.stop_vertices.size() != transport_catalogue_->GetStopCount()) {
+            throw std::invalid_argument("Router state does not match the catalogue");
+        }
+        for (const size_t stop_id : state.vertex_stops) {
+            if (stop_id >= transport_catalogue_->GetStopCount()) {
+                throw std::invalid_argument("Router state has a vertex stop out of range");
+            }
+        }
+        // Рёбра уже в порядке id: построитель разложит их на те же места
+        GraphBuilder builder(state.vertex_count);
+        for (size_t i = 0; i < state.edges.size(); ++i) {
+            if (i > 0 && state.edges[i].from < state.edges[i - 1].from) {
+                throw std::invalid_argument("Router state edges are not ordered by vertex");
+            }
+            builder.AddEdge(state.edges[i]);
+        }
+        for (const auto& [wait, board] : state.stop_vertices) {
+            if ((wait != NO_VERTEX && wait >= state.vertex_count) || (board != NO_VERTEX && board >= state.vertex_count)) {
+                throw std::invalid_argument("Router state has a stop vertex out of range");
+            }
+        }
+        graph_ = std::make_unique<Graph>(builder.Build());
+        edges_descriptions_ = std::move(state.edges_descriptions);
+        stop_vertices_ = std::move(state.stop_vertices);
+        vertex_stops_ = std::move(state.vertex_stops);
+        MakeEngine(std::move(state.routes));
+    }
+
+    void TransportRouter::MakeEngine(std::optional<Router::RoutesInternalData> routes) {
+        if (routing_settings_.router_engine_ == RouterEngine::DIJKSTRA && routing_settings_.tree_cache_bytes_ > 0) {
+            auto dijkstra = std::make_unique<graph::DijkstraRouter<double>>(*graph_);
+            tree_builder_ = dijkstra.get();
+            router_ = std::move(dijkstra);
+            // Дерево занимает O(V) памяти, поэтому кэш из одного шарда: иначе доля шарда может не вместить ни одного
+            tree_cache_ = std::make_unique<TreeCache>(routing_settings_.tree_cache_bytes_, 1);
+        } else if (routing_settings_.router_engine_ == RouterEngine::A_STAR) {
+            router_ = std::make_unique<AStarRouter>(*graph_, MakeTravelTimeLowerBound());
+        } else if (routing_settings_.router_engine_ == RouterEngine::FLOYD_WARSHALL && routes) {
+            router_ = std::make_unique<Router>(*graph_, std::move(*routes));
+        } else {
+            router_ = MakeRouter(routing_settings_.router_engine_, *graph_);
+        }
+    }
+
+    lru_cache::CacheStats TransportRouter::GetRouteCacheStats() const {
+        return route_cache_ ? route_cache_->GetStats() : lru_cache::CacheStats{};
+    }
+
+    lru_cache::CacheStats TransportRouter::GetTreeCacheStats() const {
+        return tree_cache_ ? tree_cache_->GetStats() : lru_cache::CacheStats{};
+    }
+
+    size_t TransportRouter::GetRouterMemoryUsage() const {
+        if (raptor_) {
+            return raptor_->GetMemoryUsage();
+        }
+        return router_ ? router_->GetMemoryUsage() : 0;
+    }
+
+    size_t TransportRouter::GetGraphMemoryUsage() const {
+        return graph_ ? graph_->GetMemoryUsage() : 0;
+    }
+
+    uint64_t TransportRouter::GetSettledVertexCount() const {
+        if (raptor_) {
+            return raptor_->GetScannedPositionCount();
+        }
+        return router_ ? router_->GetSettledVertexCount() : 0;
+    }
+
+    RouterState TransportRouter::GetState() const {
+        RouterState state;
+        if (!graph_) {
+            return state;
+        }
+        state.vertex_count = graph_->GetVertexCount();
+        state.edges.reserve(graph_->GetEdgeCount());
+        for (graph::EdgeId edge_id = 0; edge_id < graph_->GetEdgeCount(); ++edge_id) {
+            state.edges.push_back(graph_->GetEdge(edge_id));
+        }
+        state.edges_descriptions = edges_descriptions_;
+        state.stop_vertices = stop_vertices_;
+        state.vertex_stops = vertex_stops_;
+        if (const auto* floyd_warshall = dynamic_cast<const Router*>(router_.get())) {
+            state.routes = floyd_warshall->GetRoutesInternalData();
+        }
+        return state;
     }
 
     const RoutingSettings& TransportRouter::GetRoutingSettings() const & {
@@ -19,60 +178,243 @@ namespace transport_router {
         return graph_;
     }
 
-    const std::unique_ptr<Router>& TransportRouter::GetRouter() const & {
+    const std::unique_ptr<RouterBase>& TransportRouter::GetRouter() const & {
         return router_;
     }
     EdgeDescriptions& TransportRouter::GetEdgeDescription() & {
         return edges_descriptions_;
     }
-    const std::unordered_map<std::string_view, std::pair<size_t, size_t>>& TransportRouter::GetPairsOfVertices() const & {
-        return pairs_of_vertices_for_each_stop_;
-    }
     const EdgeDescriptions &TransportRouter::GetEdgeDescriptions() const &{
         return edges_descriptions_;
     }
 
+    graph::VertexId TransportRouter::GetWaitVertex(std::string_view stop) const {
+        const domain::Stop* found = transport_catalogue_->FindStop(stop);
+        return found == nullptr ? NO_VERTEX : stop_vertices_[found->id].first;
+    }
+
     std::optional<EdgeDescriptions> TransportRouter::BuildRoute(std::string_view stop_from, std::string_view stop_to) const {
-        EdgeDescriptions result;
+        if (stop_from == stop_to) return EdgeDescriptions{};
+        if (raptor_) {
+            const domain::Stop* from = transport_catalogue_->FindStop(stop_from);
+            const domain::Stop* to = transport_catalogue_->FindStop(stop_to);
+            if (from == nullptr || to == nullptr) return std::nullopt;
+            return BuildRaptorRoute(from, to);
+        }
+        const graph::VertexId from_id = GetWaitVertex(stop_from);
+        const graph::VertexId to = GetWaitVertex(stop_to);
+        if (from_id == NO_VERTEX || to == NO_VERTEX) return std::nullopt;
+        return BuildRoute(from_id, to);
+    }
+
+    std::vector<std::optional<EdgeDescriptions>> TransportRouter::BuildRoutes(const std::vector<RouteQuery>& queries) const {
+        std::vector<std::optional<EdgeDescriptions>> results(queries.size());
+        if (!tree_cache_) {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                results[i] = BuildRoute(queries[i].first, queries[i].second);
+            }
+            return results;
+        }
+
+        struct Pending {
+            size_t index;
+            graph::VertexId from;
+            graph::VertexId to;
+            std::optional<TreeKey> tree;
+        };
+        std::vector<Pending> pending;
+        std::unordered_map<graph::VertexId, size_t> from_count;
+        std::unordered_map<graph::VertexId, size_t> to_count;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (queries[i].first == queries[i].second) {
+                results[i] = EdgeDescriptions{};
+                continue;
+            }
+            const graph::VertexId from = GetWaitVertex(queries[i].first);
+            const graph::VertexId to = GetWaitVertex(queries[i].second);
+            if (from != NO_VERTEX && to != NO_VERTEX) {
+                pending.push_back({i, from, to, std::nullopt});
+                ++from_count[from];
+                ++to_count[to];
+            }
+        }
 
-        if (stop_from == stop_to) return result;
-        if (pairs_of_vertices_for_each_stop_.count(stop_from) == 0
-            || pairs_of_vertices_for_each_stop_.count(stop_to) == 0) return std::nullopt;
+        for (Pending& query : pending) {
+            const size_t from_group = from_count[query.from];
+            const size_t to_group = to_count[query.to];
+            if (from_group > 1 && from_group >= to_group) {
+                query.tree = TreeKey{query.from, Tree::Direction::FORWARD};
+            } else if (to_group > 1) {
+                query.tree = TreeKey{query.to, Tree::Direction::BACKWARD};
+            }
+        }
+        // Запросы одной группы идут подряд, чтобы её дерево строилось один раз
+        std::stable_sort(pending.begin(), pending.end(), [](const Pending& lhs, const Pending& rhs) {
+            return lhs.tree < rhs.tree;
+        });
+
+        std::shared_ptr<const Tree> tree;
+        for (const Pending& query : pending) {
+            if (!query.tree) {
+                results[query.index] = BuildRoute(query.from, query.to);
+                continue;
+            }
+            if (!tree || tree->root != query.tree->first || tree->direction != query.tree->second) {
+                tree = GetTree(*query.tree);
+            }
+            results[query.index] = BuildRoute(query.from, query.to, tree.get());
+        }
+        return results;
+    }
 
-        graph::VertexId from_id = pairs_of_vertices_for_each_stop_.at(stop_from).first;
-        graph::VertexId to = pairs_of_vertices_for_each_stop_.at(stop_to).first;
-        std::optional<Router::RouteInfo> route = router_->BuildRoute(from_id, to);
+    std::optional<EdgeDescriptions> TransportRouter::BuildRaptorRoute(const domain::Stop* from, const domain::Stop* to) const {
+        if (route_cache_) {
+            if (auto cached = route_cache_->Get({from->id, to->id})) {
+                return std::move(*cached);
+            }
+        }
+        std::optional<EdgeDescriptions> route = raptor_->BuildRoute(from, to);
+        if (route_cache_) route_cache_->Put({from->id, to->id}, route);
+        return route;
+    }
+
+    std::shared_ptr<const Tree> TransportRouter::GetTree(const TreeKey& key) const {
+        if (auto cached = tree_cache_->Get(key)) {
+            return *cached;
+        }
+        auto tree = std::make_shared<const Tree>(tree_builder_->BuildTree(key.first, key.second));
+        tree_cache_->Put(key, tree);
+        return tree;
+    }
+
+    std::optional<EdgeDescriptions> TransportRouter::BuildRoute(graph::VertexId from_id, graph::VertexId to, const Tree* tree) const {
+        EdgeDescriptions result;
+        if (route_cache_) {
+            if (auto cached = route_cache_->Get({from_id, to})) {
+                return std::move(*cached);
+            }
+        }
+        std::shared_ptr<const Tree> cached_tree;
+        if (tree == nullptr && tree_cache_) {
+            // Дерево, оставшееся от прошлых пачек, отвечает и на одиночный запрос
+            auto found = tree_cache_->Get({from_id, Tree::Direction::FORWARD});
+            if (!found) {
+                found = tree_cache_->Get({to, Tree::Direction::BACKWARD});
+            }
+            if (found) {
+                cached_tree = std::move(*found);
+                tree = cached_tree.get();
+            }
+        }
+        std::optional<RouterBase::RouteInfo> route = tree == nullptr
+                ? router_->BuildRoute(from_id, to)
+                : tree->BuildRoute(*graph_, tree->direction == Tree::Direction::FORWARD ? to : from_id);
 
-        if (!route.has_value()) return std::nullopt;
+        if (!route.has_value()) {
+            if (route_cache_) route_cache_->Put({from_id, to}, std::nullopt);
+            return std::nullopt;
+        }
 
         const auto& ed = GetEdgeDescriptions();
 
         for (graph::VertexId id : route.value().edges) {
-            result.push_back(ed[id]);
+            AppendItem(result, ed[id]);
         }
+        if (route_cache_) route_cache_->Put({from_id, to}, result);
         return result;
     }
 
 void TransportRouter::FillGraph()
 {
-    AddWaitEdgesToGraph();
-    for (const auto [name, bus_ptr] : transport_catalogue_->GetBusIndexes())
-    {
-        AddBusEdgesToGraph(bus_ptr->stop.begin(), bus_ptr->stop.end(), name);
-        if (!bus_ptr->ring_route)
+    const bool route_lines = routing_settings_.graph_model_ == GraphModel::ROUTE_LINES;
+    const size_t vertex_count = GetGraphVertexCount(*transport_catalogue_, routing_settings_.graph_model_);
+    GraphBuilder builder(vertex_count);
+    vertex_stops_.assign(vertex_count, 0);
+    if (route_lines) {
+        AddStopVertices();
+        graph::VertexId next_vertex = transport_catalogue_->GetAmountOfUsedStops();
+        for (const auto& [name, bus_ptr] : transport_catalogue_->GetBusIndexes()) {
+            next_vertex = AddRouteLineToGraph(builder, *bus_ptr, next_vertex);
+        }
+    } else {
+        AddWaitEdgesToGraph(builder);
+        for (const auto& [name, bus_ptr] : transport_catalogue_->GetBusIndexes())
         {
-            AddBusEdgesToGraph(bus_ptr->stop.crbegin(),bus_ptr->stop.crend(), name);
+            AddBusEdgesToGraph(builder, *bus_ptr);
         }
     }
+    graph_ = std::make_unique<Graph>(builder.Build());
+    // Описания добавлялись вместе с рёбрами, а id рёбер в графе упорядочены по вершинам
+    edges_descriptions_ = builder.Reorder(std::move(edges_descriptions_));
 }
 
+    TravelTimeLowerBound TransportRouter::MakeTravelTimeLowerBound() const {
+        // По id остановки; пока minutes_per_meter равен 1, оценка возвращает саму хорду
+        TravelTimeLowerBound stop_chords;
+        stop_chords.minutes_per_meter = 1.0;
+        for (const domain::Stop& stop : transport_catalogue_->GetAllStops()) {
+            const double lat = stop.coordinates.lat * geo::DEG_TO_RAD;
+            const double lng = stop.coordinates.lng * geo::DEG_TO_RAD;
+            stop_chords.points.push_back({geo::radius_earth * std::cos(lat) * std::cos(lng),
+                                          geo::radius_earth * std::cos(lat) * std::sin(lng),
+                                          geo::radius_earth * std::sin(lat)});
+        }
+        TravelTimeLowerBound bound;
+        bound.points.reserve(vertex_stops_.size());
+        for (const size_t stop_id : vertex_stops_) {
+            bound.points.push_back(stop_chords.points[stop_id]);
+        }
+
+        // Наименьшее отношение дорожного расстояния к хорде по всем перегонам, где хорда ненулевая
+        double ratio = std::numeric_limits<double>::infinity();
+        for (const domain::Bus& bus : transport_catalogue_->GetAllBuses()) {
+            const domain::RouteView route(bus);
+            for (size_t i = 0; i + 1 < route.size(); ++i) {
+                const double chord = stop_chords(route[i]->id, route[i + 1]->id);
+                if (chord > 0.0) {
+                    ratio = std::min(ratio, transport_catalogue_->GetRoadDistanceOnBus(bus, i, i + 1) / chord);
+                }
+            }
+        }
+        if (std::isinf(ratio)) {
+            ratio = 0.0;
+        }
+        // Запас на погрешность округления, чтобы оценка не превысила вес ребра на последнем бите
+        constexpr double ROUNDING_MARGIN = 1.0 - 1e-9;
+        bound.minutes_per_meter = ratio * ROUNDING_MARGIN * MIN_PER_HOUR / METERS_PER_KM / routing_settings_.bus_velocity_;
+        return bound;
+    }
+
+    void TransportRouter::AddBusEdgesToGraph(GraphBuilder& builder, const domain::Bus& bus) {
+        const domain::RouteView route(bus);
+        const size_t size = route.size();
+        // Вершины остановок маршрута ищем один раз, а не на каждое ребро
+        std::vector<std::pair<graph::VertexId, graph::VertexId>> vertices(size);
+        for (size_t i = 0; i < size; ++i) {
+            vertices[i] = stop_vertices_[route[i]->id];
+        }
+        const double minutes_per_meter = MIN_PER_HOUR / METERS_PER_KM / routing_settings_.bus_velocity_;
+        for (size_t from = 0; from + 1 < size; ++from) {
+            for (size_t span = 1; from + span < size; ++span) {
+                const size_t to = from + span;
+                const double time = transport_catalogue_->GetRoadDistanceOnBus(bus, from, to) * minutes_per_meter;
+                builder.AddEdge({vertices[from].second, vertices[to].first, time});
+                edges_descriptions_.push_back({EdgeType::BUS, bus.name, time, static_cast<int>(span)});
+            }
+        }
+    }
+
 
-    void TransportRouter::AddWaitEdgesToGraph() {
+    void TransportRouter::AddWaitEdgesToGraph(GraphBuilder& builder) {
         graph::VertexId from_id = 0;
         graph::VertexId to_id = 1;
+        stop_vertices_.assign(transport_catalogue_->GetStopCount(), {NO_VERTEX, NO_VERTEX});
         for (std::string_view name: transport_catalogue_->GetUsedStopNames()) {
-            graph_->AddEdge({from_id, to_id, routing_settings_.bus_wait_time_});
-            pairs_of_vertices_for_each_stop_.insert({name, {from_id, to_id}});
+            builder.AddEdge({from_id, to_id, routing_settings_.bus_wait_time_});
+            const size_t stop_id = transport_catalogue_->FindStop(name)->id;
+            stop_vertices_[stop_id] = {from_id, to_id};
+            vertex_stops_[from_id] = stop_id;
+            vertex_stops_[to_id] = stop_id;
            // std::cerr <<  " name " << name << " form_id " << from_id << " to_id " << to_id << std::endl;
             GetEdgeDescription().push_back({
                 EdgeType::WAIT,
@@ -84,4 +426,39 @@ void TransportRouter::FillGraph()
             to_id += 2;
         }
     }
+
+    void TransportRouter::AddStopVertices() {
+        stop_vertices_.assign(transport_catalogue_->GetStopCount(), {NO_VERTEX, NO_VERTEX});
+        graph::VertexId vertex = 0;
+        for (std::string_view name : transport_catalogue_->GetUsedStopNames()) {
+            const size_t stop_id = transport_catalogue_->FindStop(name)->id;
+            stop_vertices_[stop_id] = {vertex, NO_VERTEX};
+            vertex_stops_[vertex++] = stop_id;
+        }
+    }
+
+    graph::VertexId TransportRouter::AddRouteLineToGraph(GraphBuilder& builder, const domain::Bus& bus, graph::VertexId first_vertex) {
+        const domain::RouteView route(bus);
+        const size_t size = route.size();
+        const double minutes_per_meter = MIN_PER_HOUR / METERS_PER_KM / routing_settings_.bus_velocity_;
+        for (size_t position = 0; position < size; ++position) {
+            const domain::Stop* stop = route[position];
+            const graph::VertexId line = first_vertex + position;
+            const graph::VertexId stop_vertex = stop_vertices_[stop->id].first;
+            vertex_stops_[line] = stop->id;
+            // На последней позиции не садятся, на первой не выходят
+            if (position + 1 < size) {
+                builder.AddEdge({stop_vertex, line, routing_settings_.bus_wait_time_});
+                edges_descriptions_.push_back({EdgeType::WAIT, stop->name, routing_settings_.bus_wait_time_, std::nullopt});
+                const double time = transport_catalogue_->GetRoadDistanceOnBus(bus, position, position + 1) * minutes_per_meter;
+                builder.AddEdge({line, line + 1, time});
+                edges_descriptions_.push_back({EdgeType::BUS, bus.name, time, 1});
+            }
+            if (position > 0) {
+                builder.AddEdge({line, stop_vertex, 0.0});
+                edges_descriptions_.push_back({EdgeType::ALIGHT, stop->name, 0.0, std::nullopt});
+            }
+        }
+        return first_vertex + size;
+    }
 }
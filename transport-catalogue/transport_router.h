@@ -2,23 +2,56 @@
 
 #include "transport_catalogue.h"
 #include "router.h"
+#include "dijkstra_router.h"
+#include "ch_router.h"
+#include "lru_cache.h"
 #include "graph.h"
 #include <iostream>
 #include <memory>
 #include "algorithm"
+#include <limits>
+#include <cmath>
+#include <vector>
+
+namespace raptor {
+    class RaptorRouter;
+}
 
 namespace transport_router {
     constexpr static double METERS_PER_KM = 1000.0;
     constexpr static double MIN_PER_HOUR = 60.0;
+    constexpr static graph::VertexId NO_VERTEX = std::numeric_limits<graph::VertexId>::max();
+
+    // Алгоритм поиска кратчайшего пути по графу маршрутизатора
+    enum class RouterEngine {
+        FLOYD_WARSHALL, // Все пары заранее: быстрые запросы, но O(V^3) на старте и O(V^2) памяти
+        DIJKSTRA,       // По запросу: O(V + E) на старте и в памяти
+        CONTRACTION_HIERARCHIES, // Предобработка сжатием вершин, затем двунаправленный поиск вверх по иерархии
+        A_STAR,         // Дейкстра, направленная к цели оценкой времени по прямой (TravelTimeLowerBound)
+        BIDIRECTIONAL_DIJKSTRA, // Встречные поиски из обеих остановок, без предобработки
+        RAPTOR          // Раунды по маршрутам справочника без графа (raptor::RaptorRouter)
+    };
+
+    // Устройство графа маршрутизатора
+    enum class GraphModel {
+        STOP_PAIRS,  // Две вершины на остановку, ребро от каждой остановки маршрута до каждой последующей: O(k^2) рёбер
+        ROUTE_LINES  // Вершина на остановку и на каждую позицию маршрута, поездки только между соседними позициями: O(k) рёбер
+    };
 
     struct RoutingSettings {
         double bus_wait_time_ = 0.0;
         double bus_velocity_ = 0.0;
+        size_t shard_count_ = 1; // Число шардов экспериментального прототипа в одном процессе, 1 — обычный маршрутизатор (см. sharded_router.h)
+        RouterEngine router_engine_ = RouterEngine::FLOYD_WARSHALL;
+        size_t route_cache_bytes_ = 0; // Ёмкость кэша готовых маршрутов, 0 — без кэша
+        size_t tree_cache_bytes_ = 0;  // Память под деревья кратчайших путей для BuildRoutes (только DIJKSTRA), 0 — без деревьев
+        GraphModel graph_model_ = GraphModel::STOP_PAIRS;
     };
 
     enum class EdgeType {
         WAIT,
-        BUS
+        BUS,
+        ALIGHT // Выход из автобуса в модели ROUTE_LINES, в ответы не попадает
     };
 
     struct EdgeDescription {
@@ -28,59 +61,183 @@ namespace transport_router {
         std::optional<int> span_count_ = 0;
     };
 
+    using RouterBase = graph::RouterBase<double>;
     using Router = graph::Router<double>;
     using Graph = graph::DirectedWeightedGraph<double>;
+    using GraphBuilder = graph::GraphBuilder<double>;
     using EdgeDescriptions = std::vector<EdgeDescription>;
 
+    /**
+     * Оценка снизу времени в пути между вершинами графа для A*: длина хорды между их остановками
+     * (прямая сквозь Землю, не длиннее расстояния по поверхности), умноженная на minutes_per_meter.
+     * Дорожное расстояние в справочнике бывает короче прямой, поэтому minutes_per_meter учитывает наименьшее
+     * по перегонам маршрутов отношение дорожного расстояния к хорде: тогда оценка не превосходит времени
+     * ни одной поездки, а по неравенству треугольника для хорд остаётся согласованной.
+     */
+    struct TravelTimeLowerBound {
+        struct Point {
+            double x = 0.0;
+            double y = 0.0;
+            double z = 0.0;
+        };
+
+        std::vector<Point> points; // По вершине графа: положение её остановки в метрах от центра Земли
+        double minutes_per_meter = 0.0;
+
+        double operator()(graph::VertexId from, graph::VertexId to) const {
+            const Point& lhs = points[from];
+            const Point& rhs = points[to];
+            const double dx = lhs.x - rhs.x;
+            const double dy = lhs.y - rhs.y;
+            const double dz = lhs.z - rhs.z;
+            return std::sqrt(dx * dx + dy * dy + dz * dz) * minutes_per_meter;
+        }
+    };
+
+    using AStarRouter = graph::AStarRouter<double, TravelTimeLowerBound>;
+
+    /**
+     * Создаёт маршрутизатор выбранного алгоритма по графу graph, граф должен пережить маршрутизатор.
+     * Оценке A* нужны остановки вершин, которых у произвольного графа нет, поэтому A_STAR здесь даёт
+     * DijkstraRouter (A* с нулевой оценкой); с оценкой его строит TransportRouter.
+     * RAPTOR ищет не по графу, а по маршрутам справочника, поэтому для графа тоже даёт DijkstraRouter.
+     */
+    std::unique_ptr<RouterBase> MakeRouter(RouterEngine engine, const Graph& graph);
+
+    // Число вершин графа маршрутизатора по справочнику в модели graph_model
+    size_t GetGraphVertexCount(const transport_catalogue::TransportCatalogue& catalogue, GraphModel graph_model);
+
+    struct VertexPairHasher {
+        size_t operator()(const std::pair<graph::VertexId, graph::VertexId>& vertices) const {
+            return vertices.first * 0x9E3779B97F4A7C15ull ^ vertices.second;
+        }
+    };
+
+    struct RouteSize {
+        size_t operator()(const std::optional<EdgeDescriptions>& route) const {
+            return route ? route->capacity() * sizeof(EdgeDescription) : 0;
+        }
+    };
+
+    // Кэш по паре вершин ожидания (у RAPTOR — по паре id остановок); недостижимые пары тоже кэшируются, как std::nullopt
+    using RouteCache = lru_cache::ShardedLruCache<std::pair<graph::VertexId, graph::VertexId>,
+                                                  std::optional<EdgeDescriptions>, VertexPairHasher, RouteSize>;
+
+    using Tree = graph::ShortestPathTree<double>;
+    using TreeKey = std::pair<graph::VertexId, Tree::Direction>;
+
+    struct TreeKeyHasher {
+        size_t operator()(const TreeKey& key) const {
+            return key.first * 2 + (key.second == Tree::Direction::BACKWARD ? 1 : 0);
+        }
+    };
+
+    struct TreeSize {
+        size_t operator()(const std::shared_ptr<const Tree>& tree) const {
+            return tree->GetMemoryUsage();
+        }
+    };
+
+    // Деревья кратчайших путей по корню и направлению
+    using TreeCache = lru_cache::ShardedLruCache<TreeKey, std::shared_ptr<const Tree>, TreeKeyHasher, TreeSize>;
+
+    // Запрос маршрута: остановка отправления и остановка прибытия
+    using RouteQuery = std::pair<std::string_view, std::string_view>;
+
+    /**
+     * Всё, что TransportRouter строит по справочнику, в виде для сохранения между запусками
+     * (serialization::SerializeRouterState): рёбра графа в порядке id, их описания, вершины остановок
+     * и у Флойда–Уоршелла матрица последних рёбер путей. Имена в описаниях должны указывать в справочник,
+     * с которым состояние передаётся в TransportRouter.
+     */
+    struct RouterState {
+        size_t vertex_count = 0;
+        std::vector<graph::Edge<double>> edges; // Упорядочены по исходящей вершине, как id в DirectedWeightedGraph
+        EdgeDescriptions edges_descriptions;
+        std::vector<std::pair<graph::VertexId, graph::VertexId>> stop_vertices;
+        std::vector<size_t> vertex_stops;
+        std::optional<Router::RoutesInternalData> routes;
+    };
+
+   /**
+    * Маршрутизатор по справочнику, которым он владеет вместе с вызывающим (shared_ptr): справочник не копируется
+    * и не должен меняться, пока маршрутизатор жив. Справочник и настройки задаются
+    * только в конструкторе, поэтому кэш маршрутов живёт ровно столько, сколько маршрутизатор:
+    * при изменении базы или routing_settings строится новый маршрутизатор с пустым кэшем.
+    */
    class TransportRouter {
     public:
-       TransportRouter() = default;
-       TransportRouter(RoutingSettings settings, std::unique_ptr<transport_catalogue::TransportCatalogue> &&transport_catalogue);
+       TransportRouter();
+       TransportRouter(RoutingSettings settings, std::shared_ptr<const transport_catalogue::TransportCatalogue> transport_catalogue);
+       // Из сохранённого состояния, без построения графа и предобработки; state должен быть построен по тому же
+       // справочнику и с теми же настройками, при несогласованном state бросает std::invalid_argument
+       TransportRouter(RoutingSettings settings, std::shared_ptr<const transport_catalogue::TransportCatalogue> transport_catalogue,
+                       RouterState&& state);
+       // raptor::RaptorRouter здесь неполный тип, поэтому перемещение и деструктор определены в transport_router.cpp
+       TransportRouter(TransportRouter&& other) noexcept;
+       TransportRouter& operator=(TransportRouter&& other) noexcept;
+       ~TransportRouter();
 
        const RoutingSettings& GetRoutingSettings() const &;
        std::optional<EdgeDescriptions> BuildRoute(std::string_view stop_from, std::string_view stop_to) const;
-
-        template<typename InputIterator>
-        void AddBusEdgesToGraph(InputIterator first, InputIterator last, std::string_view bus_name) {
-            for (; std::distance(first, last) != 1; first++) {
-                graph::VertexId from_id = GetPairsOfVertices().at((*first)->name).second;
-                const domain::Stop* from_stop = *first;
-                double time = 0.0;
-                InputIterator next_after_first = first;
-                for (std::advance(next_after_first, 1); next_after_first != last; next_after_first++) {
-                    graph::VertexId to_id = GetPairsOfVertices().at((*next_after_first)->name).first;
-                    time += transport_catalogue_->GetDistanceBetweenStops(from_stop,*next_after_first) /
-                            METERS_PER_KM / GetRoutingSettings().bus_velocity_ * MIN_PER_HOUR;
-                    //std::cerr  << "bus " << bus_name << " from stop " << from_stop->name_ << " to stop " << (*next_after_first)->name_ << " from_id " << from_id << " to_id " << to_id << std::endl;
-                    GetGraph()->AddEdge({from_id, to_id, time});
-                    from_stop = *next_after_first;
-                    GetEdgeDescription().push_back({
-                                                          EdgeType::BUS,
-                                                          bus_name,
-                                                          time,
-                                                          std::distance(first, next_after_first)
-                                                  });
-                }
-            }
-        }
+       /**
+        * Ответы на пачку запросов в том же порядке.
+        * С кэшем деревьев запросы группируются по общей остановке отправления или прибытия
+        * (по той, что встречается чаще): для группы из двух и более запросов один раз строится
+        * прямое или обратное дерево кратчайших путей, и маршруты читаются из него.
+        */
+       std::vector<std::optional<EdgeDescriptions>> BuildRoutes(const std::vector<RouteQuery>& queries) const;
+       // Счётчики кэшей, нули, если кэш выключен
+       lru_cache::CacheStats GetRouteCacheStats() const;
+       lru_cache::CacheStats GetTreeCacheStats() const;
+       // Примерный объём памяти алгоритма поиска пути, без графа и описаний рёбер
+       size_t GetRouterMemoryUsage() const;
+       // Память графа маршрутизации (CSR), без описаний рёбер; у RAPTOR графа нет, 0
+       size_t GetGraphMemoryUsage() const;
+       // Сколько вершин извлёк алгоритм поиска по всем запросам, мимо кэшей; у Флойда–Уоршелла 0,
+       // у RAPTOR — сколько позиций маршрутов просмотрено
+       uint64_t GetSettledVertexCount() const;
+       // Копия построенного состояния для сохранения; у RAPTOR графа нет, и состояние пустое
+       RouterState GetState() const;
 
     private:
 
         std::unique_ptr<Graph>& GetGraph() &;
         const std::unique_ptr<Graph>& GetGraph() const &;
-        const std::unique_ptr<Router>& GetRouter() const &;
+        const std::unique_ptr<RouterBase>& GetRouter() const &;
         EdgeDescriptions& GetEdgeDescription() &;
-        const std::unordered_map<std::string_view, std::pair<size_t, size_t>>& GetPairsOfVertices() const &;
         const EdgeDescriptions& GetEdgeDescriptions() const &;
+        // Вершина ожидания остановки или NO_VERTEX, если остановки нет или через неё не проходят маршруты
+        graph::VertexId GetWaitVertex(std::string_view stop) const;
+        // Маршрут между вершинами ожидания: из кэша маршрутов, из дерева tree (если задано) или поиском
+        std::optional<EdgeDescriptions> BuildRoute(graph::VertexId from, graph::VertexId to, const Tree* tree = nullptr) const;
+        // Маршрут между остановками через raptor_, с кэшем маршрутов
+        std::optional<EdgeDescriptions> BuildRaptorRoute(const domain::Stop* from, const domain::Stop* to) const;
+        std::shared_ptr<const Tree> GetTree(const TreeKey& key) const;
 
         RoutingSettings routing_settings_;
-        std::unique_ptr<transport_catalogue::TransportCatalogue> transport_catalogue_;
+        std::shared_ptr<const transport_catalogue::TransportCatalogue> transport_catalogue_;
         std::unique_ptr<Graph> graph_;
-        std::unique_ptr<Router> router_;
-        std::unordered_map<std::string_view, std::pair<size_t, size_t>> pairs_of_vertices_for_each_stop_;
+        std::unique_ptr<RouterBase> router_;
+        // Пара вершин (ожидание, посадка) для каждой остановки по её id; у остановок без маршрутов — NO_VERTEX.
+        // В модели ROUTE_LINES у остановки одна вершина, посадки нет
+        std::vector<std::pair<graph::VertexId, graph::VertexId>> stop_vertices_;
+        std::vector<size_t> vertex_stops_; // По вершине графа: id её остановки
         EdgeDescriptions edges_descriptions_;
+        std::unique_ptr<RouteCache> route_cache_; // Сам кэш потокобезопасен, поэтому доступен из const BuildRoute
+        const graph::DijkstraRouter<double>* tree_builder_ = nullptr; // router_, если включён кэш деревьев
+        std::unique_ptr<TreeCache> tree_cache_;
+        std::unique_ptr<raptor::RaptorRouter> raptor_; // Вместо графа и router_, если выбран RAPTOR
 
         void FillGraph();
-        void AddWaitEdgesToGraph();
+        // Алгоритм поиска по построенному графу; routes — готовая матрица Флойда–Уоршелла, если есть
+        void MakeEngine(std::optional<Router::RoutesInternalData> routes = std::nullopt);
+        void AddStopVertices();
+        // Позиции полного маршрута — вершины с first_vertex, возвращает следующую свободную вершину
+        graph::VertexId AddRouteLineToGraph(GraphBuilder& builder, const domain::Bus& bus, graph::VertexId first_vertex);
+        TravelTimeLowerBound MakeTravelTimeLowerBound() const;
+        void AddWaitEdgesToGraph(GraphBuilder& builder);
+        // Рёбра от каждой остановки полного маршрута (domain::RouteView) до каждой последующей
+        void AddBusEdgesToGraph(GraphBuilder& builder, const domain::Bus& bus);
     };
 }
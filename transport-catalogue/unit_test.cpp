@@ -1,5 +1,11 @@
  #include "unit_test.h"
 #include "transport_catalogue.h"
+#include "serialization.h"
+#include "counting_resource.h"
+#include "sharded_router.h"
+#include "benchmark.h"
+#include "raptor_router.h"
+#include "min_plus.h"
 
 using namespace std::literals;
 
@@ -84,7 +90,7 @@ template<typename TestFunc>
 
         transport_catalogue::TransportCatalogue sut = FillingRoutes();
         std::vector<std::string_view> bus_stop = {"Tolstopaltsevo"sv,"Rasskazovka"sv,"Biryulyovo Zapadnoye"sv};
-        sut.AddBus("750"s, bus_stop);
+        sut.AddBus("750"s, bus_stop, false);
 
         ASSERT_EQUAL_HINT(sut.NumberOfRoutes(), 1u,
                                     "Маршрут добавляется не корректно."s);
@@ -95,7 +101,7 @@ template<typename TestFunc>
         transport_catalogue::TransportCatalogue sut = FillingRoutes();
 
         std::vector<std::string_view> bus_stop = {"Tolstopaltsevo"sv,""s,"Biryulyovo Zapadnoye"sv};
-        sut.AddBus("750"s, bus_stop);
+        sut.AddBus("750"s, bus_stop, false);
 
         ASSERT_EQUAL_HINT(sut.NumberOfRoutes(), 0u,
                                     "Маршрут был построен даже с пустой остановкой."s);
@@ -106,7 +112,7 @@ template<typename TestFunc>
         transport_catalogue::TransportCatalogue sut = FillingRoutes();
 
         std::vector<std::string_view> bus_stop = {"Tolstopaltsevo"sv,"Rasskazovka1"sv,"Biryulyovo Zapadnoye"sv};
-        sut.AddBus("750"s, bus_stop);
+        sut.AddBus("750"s, bus_stop, false);
 
         ASSERT_EQUAL_HINT(sut.NumberOfRoutes(), 0u,
                                     "Маршрут был построен даже с неизвестной остановкой."s);
@@ -117,7 +123,7 @@ template<typename TestFunc>
         transport_catalogue::TransportCatalogue sut = FillingRoutes();
 
         std::vector<std::string_view> bus_stop = {"Tolstopaltsevo"sv,"Rasskazovka"sv,"Biryulyovo Zapadnoye"sv};
-        sut.AddBus("750"s, bus_stop);
+        sut.AddBus("750"s, bus_stop, false);
 
         ASSERT_EQUAL_HINT_POINTER(sut.FindBus("750"s), nullptr,
                                     "Не находит автобус который введен в систему."s);
@@ -128,7 +134,7 @@ template<typename TestFunc>
         transport_catalogue::TransportCatalogue sut = FillingRoutes();
 
         std::vector<std::string_view> bus_stop = {"Tolstopaltsevo"sv,"Rasskazovka"sv,"Biryulyovo Zapadnoye"sv};
-        sut.AddBus("750"s, bus_stop);
+        sut.AddBus("750"s, bus_stop, false);
 
         ASSERT_NOT_EQUAL_HINT_POINTER(sut.FindBus("880"s), nullptr,
                                     "Находит маршрут который не был введен в систему."s);
@@ -138,7 +144,7 @@ template<typename TestFunc>
         transport_catalogue::TransportCatalogue sut = FillingRoutes();
 
         std::vector<std::string_view> bus_stop = {"Tolstopaltsevo"sv,"Rasskazovka"sv,"Biryulyovo Zapadnoye"sv,"Rasskazovka"sv};
-        sut.AddBus("750"s, bus_stop);
+        sut.AddBus("750"s, bus_stop, true);
         auto info = sut.GetBusInfo("750"s);
 
         ASSERT_EQUAL_HINT(info.unique_stops_count, 3u,
@@ -157,9 +163,1010 @@ template<typename TestFunc>
         sut.AddBus("750"s, bus_stop, false);
         auto info = sut.GetBusInfo("750"s);
 
-        ASSERT_EQUAL_HINT(info.route_length, 200u,
+        // Туда 200 метров, обратно расстояние не задано и берётся прямое
+        ASSERT_EQUAL_HINT(info.route_length, 400u,
                                                 "Не верно считает расстояние между остановками."s);
+        ASSERT_EQUAL_HINT(info.no_unique_stops_count, 3u,
+                                                "Некольцевой маршрут должен учитывать обратный путь."s);
+
+    }
+
+    void test::Search_for_nearby_stops(){
+        transport_catalogue::TransportCatalogue sut = FillingRoutes();
+        sut.AddStop({"Marushkino"s, {55.595884, 37.209755}});
+        sut.Freeze();
+
+        const geo::Coordinates center = {55.611087, 37.208290};
+        auto nearby = sut.FindNearbyStops(center, 2000.0, 10);
+        ASSERT_EQUAL_HINT(nearby.size(), 2u, "Не верно находит остановки в радиусе."s);
+        ASSERT_EQUAL_HINT(nearby[0].stop->name, "Tolstopaltsevo"sv, "Остановки должны быть отсортированы по расстоянию."s);
+        ASSERT_EQUAL_HINT(nearby[1].stop->name, "Marushkino"sv, "Остановки должны быть отсортированы по расстоянию."s);
+
+        nearby = sut.FindNearbyStops(center, 100000.0, 3);
+        ASSERT_EQUAL_HINT(nearby.size(), 3u, "Не учитывается ограничение на количество остановок."s);
+        ASSERT_EQUAL_HINT(nearby[2].stop->name, "Rasskazovka"sv, "Остановки должны быть отсортированы по расстоянию."s);
+
+        ASSERT_EQUAL_HINT(sut.FindNearbyStops({0.0, 0.0}, 1000.0, 10).size(), 0u,
+                          "Вдали от остановок ничего не должно находиться."s);
+    }
+
+    void test::Search_by_name_in_frozen_catalogue(){
+        transport_catalogue::TransportCatalogue sut = FillingRoutes();
+        sut.AddBus("750"s, {"Tolstopaltsevo"sv, "Rasskazovka"sv}, false);
+        sut.Freeze();
+
+        ASSERT_EQUAL_HINT_POINTER(sut.FindStop("Rasskazovka"sv), nullptr, "Остановка не находится после заморозки справочника."s);
+        ASSERT_EQUAL_HINT(sut.FindStop("Rasskazovka"sv)->name, "Rasskazovka"sv, "Найдена не та остановка."s);
+        ASSERT_NOT_EQUAL_HINT_POINTER(sut.FindStop("Rasskazovk"sv), nullptr, "Найдена несуществующая остановка."s);
+        ASSERT_EQUAL_HINT(sut.StopExists("Biryulyovo Zapadnoye"sv), true, "Остановка не находится после заморозки справочника."s);
+        ASSERT_EQUAL_HINT_POINTER(sut.FindBus("750"sv), nullptr, "Маршрут не находится после заморозки справочника."s);
+        ASSERT_NOT_EQUAL_HINT_POINTER(sut.FindBus("751"sv), nullptr, "Найден несуществующий маршрут."s);
+
+        // После изменения справочника поиск снова идёт по обычным словарям
+        sut.AddStop({"Marushkino"s, {55.595884, 37.209755}});
+        ASSERT_EQUAL_HINT_POINTER(sut.FindStop("Marushkino"sv), nullptr, "Новая остановка не находится до повторной заморозки."s);
+    }
+
+    void test::Checking_segment_length_on_bus(){
+        transport_catalogue::TransportCatalogue sut = FillingRoutes();
+        sut.SetDistanceBetweenStop("Rasskazovka"sv, sut.FindStop("Tolstopaltsevo"sv), 200);
+        sut.SetDistanceBetweenStop("Biryulyovo Zapadnoye"sv, sut.FindStop("Rasskazovka"sv), 300);
+        sut.SetDistanceBetweenStop("Rasskazovka"sv, sut.FindStop("Biryulyovo Zapadnoye"sv), 350);
+        sut.AddBus("750"s, {"Tolstopaltsevo"sv, "Rasskazovka"sv, "Biryulyovo Zapadnoye"sv}, false);
+        const domain::Bus& bus = *sut.FindBus("750"s);
+
+        // Полный маршрут: Tolstopaltsevo, Rasskazovka, Biryulyovo Zapadnoye, Rasskazovka, Tolstopaltsevo
+        ASSERT_EQUAL_HINT(domain::RouteView(bus).size(), 5u, "Не верно строится полный маршрут."s);
+        ASSERT_EQUAL_HINT(domain::RouteView(bus)[3]->name, "Rasskazovka"sv, "Не верно строится обратный путь."s);
+        ASSERT_EQUAL_HINT(sut.GetRoadDistanceOnBus(bus, 0, 2), 500u, "Не верно считается длина участка маршрута."s);
+        ASSERT_EQUAL_HINT(sut.GetRoadDistanceOnBus(bus, 1, 2), 300u, "Не верно считается длина участка маршрута."s);
+        ASSERT_EQUAL_HINT(sut.GetRoadDistanceOnBus(bus, 2, 3), 350u, "Не учитывается направление движения."s);
+        // Обратного расстояния Rasskazovka -> Tolstopaltsevo нет, берётся прямое
+        ASSERT_EQUAL_HINT(sut.GetRoadDistanceOnBus(bus, 2, 4), 550u, "Не верно считается длина участка маршрута."s);
+        ASSERT_EQUAL_HINT(sut.GetRoadDistanceOnBus(bus, 0, 4), 1050u, "Не верно считается длина всего маршрута."s);
+        ASSERT_EQUAL_HINT(sut.GetRoadDistanceOnBus(bus, 1, 1), 0u, "Участок из одной остановки должен иметь нулевую длину."s);
+    }
+
+    void test::Serialization_round_trip(){
+        transport_catalogue::TransportCatalogue source = FillingRoutes();
+        source.SetDistanceBetweenStop("Rasskazovka"sv, source.FindStop("Tolstopaltsevo"sv), 200);
+        source.SetDistanceBetweenStop("Tolstopaltsevo"sv, source.FindStop("Rasskazovka"sv), 300);
+        source.AddBus("750"s, {"Tolstopaltsevo"sv, "Rasskazovka"sv}, false);
+        map_render::RenderSettings render_settings;
+        render_settings.width = 600.0;
+        render_settings.color_palette = {"green"s, svg::Rgba{255, 160, 0, 0.5}};
+        transport_router::RoutingSettings routing_settings{6.0, 40.0, 1, transport_router::RouterEngine::DIJKSTRA, 4096};
+        routing_settings.graph_model_ = transport_router::GraphModel::ROUTE_LINES;
+
+        std::stringstream stream;
+        serialization::Serialize(source, render_settings, routing_settings, stream);
+
+        transport_catalogue::TransportCatalogue sut;
+        map_render::RenderSettings loaded_render_settings;
+        transport_router::RoutingSettings loaded_routing_settings;
+        serialization::Deserialize(stream, sut, loaded_render_settings, loaded_routing_settings);
+
+        ASSERT_EQUAL_HINT(sut.NumberOfStops(), source.NumberOfStops(), "Остановки не восстановились из снимка."s);
+        ASSERT_EQUAL_HINT(sut.GetBusInfo("750"s).route_length, 500.0, "Расстояния не восстановились из снимка."s);
+        ASSERT_EQUAL_HINT(loaded_render_settings.width, 600.0, "Настройки отрисовки не восстановились из снимка."s);
+        ASSERT_EQUAL_HINT(loaded_render_settings.color_palette.size(), 2u, "Палитра не восстановилась из снимка."s);
+        ASSERT_EQUAL_HINT(loaded_routing_settings.bus_velocity_, 40.0, "Настройки маршрутизации не восстановились из снимка."s);
+        ASSERT_EQUAL_HINT(loaded_routing_settings.router_engine_ == transport_router::RouterEngine::DIJKSTRA, true,
+                          "Алгоритм маршрутизации не восстановился из снимка."s);
+        ASSERT_EQUAL_HINT(loaded_routing_settings.route_cache_bytes_, 4096u, "Ёмкость кэша маршрутов не восстановилась из снимка."s);
+        ASSERT_EQUAL_HINT(loaded_routing_settings.graph_model_ == transport_router::GraphModel::ROUTE_LINES, true,
+                          "Модель графа не восстановилась из снимка."s);
+    }
+
+    void test::Search_for_direct_buses(){
+        transport_catalogue::TransportCatalogue sut = FillingRoutes();
+        sut.AddBus("750"s, {"Tolstopaltsevo"sv, "Rasskazovka"sv, "Biryulyovo Zapadnoye"sv, "Tolstopaltsevo"sv}, true);
+        sut.AddBus("751"s, {"Tolstopaltsevo"sv, "Rasskazovka"sv}, false);
+        const domain::Stop* tolstopaltsevo = sut.FindStop("Tolstopaltsevo"sv);
+        const domain::Stop* rasskazovka = sut.FindStop("Rasskazovka"sv);
+        const domain::Stop* biryulyovo = sut.FindStop("Biryulyovo Zapadnoye"sv);
+
+        for (bool frozen : {false, true}) {
+            if (frozen) {
+                sut.Freeze();
+            }
+            auto buses = sut.FindDirectBuses(rasskazovka, tolstopaltsevo);
+            ASSERT_EQUAL_HINT(buses.size(), 2u, "Не найдены маршруты без пересадки."s);
+            ASSERT_EQUAL_HINT(buses[0]->name, "750"sv, "Маршруты должны быть отсортированы по имени."s);
+            // На кольцевом маршруте от Biryulyovo Zapadnoye до Rasskazovka доехать нельзя: порядок обратный
+            ASSERT_EQUAL_HINT(sut.FindDirectBuses(biryulyovo, rasskazovka).size(), 0u, "Не учитывается порядок остановок."s);
+            ASSERT_EQUAL_HINT(sut.FindDirectBuses(biryulyovo, tolstopaltsevo).size(), 1u, "Не найдены маршруты без пересадки."s);
+        }
+
+        std::vector<uint32_t> lhs, rhs, expected, actual;
+        for (uint32_t i = 0; i < 100; ++i) {
+            lhs.push_back(i * 2);
+            rhs.push_back(i * 3);
+        }
+        sorted_set::IntersectScalar(lhs, rhs, expected);
+        sorted_set::Intersect(lhs, rhs, actual);
+        ASSERT_EQUAL_HINT(actual.size(), expected.size(), "Векторное пересечение расходится со скалярным."s);
+        ASSERT_EQUAL_HINT(actual == expected, true, "Векторное пересечение расходится со скалярным."s);
+    }
+
+    void test::Catalogue_uses_memory_resource(){
+        counting_resource::CountingResource counting;
+        std::unique_ptr<transport_catalogue::TransportCatalogue> copy;
+        {
+            transport_catalogue::TransportCatalogue sut(&counting);
+            sut.AddStop({"Tolstopaltsevo"s, {55.611087, 37.208290}});
+            sut.AddStop({"Rasskazovka"s, {55.632761, 37.333324}});
+            sut.SetDistanceBetweenStop("Rasskazovka"sv, sut.FindStop("Tolstopaltsevo"sv), 200);
+            sut.AddBus("750"s, {"Tolstopaltsevo"sv, "Rasskazovka"sv}, false);
+            sut.Freeze();
+            ASSERT_EQUAL_HINT(counting.GetAllocationCount() > 0, true, "Контейнеры справочника не используют переданный ресурс."s);
+            ASSERT_EQUAL_HINT(sut.GetMemoryResource() == &counting, true, "Справочник не запомнил переданный ресурс."s);
+            ASSERT_EQUAL_HINT(sut.FindStop("Tolstopaltsevo"sv)->name.get_allocator().resource() == &counting, true,
+                              "Имя остановки размещено не в ресурсе справочника."s);
+            ASSERT_EQUAL_HINT(sut.FindBus("750"s)->name.get_allocator().resource() == &counting, true,
+                              "Имя маршрута размещено не в ресурсе справочника."s);
+            copy = std::make_unique<transport_catalogue::TransportCatalogue>(sut);
+        }
+        ASSERT_EQUAL_HINT(counting.GetBytesInUse(), 0u, "Справочник не вернул память своему ресурсу."s);
+        // Копия живёт в собственной арене и не ссылается на разрушенный оригинал
+        ASSERT_EQUAL_HINT(copy->GetBusInfo("750"s).route_length, 400.0, "Копия справочника не самостоятельна."s);
+        ASSERT_EQUAL_HINT(copy->FindBus("750"s)->stop[1], copy->FindStop("Rasskazovka"sv), "Копия ссылается на чужие остановки."s);
+        ASSERT_EQUAL_HINT(copy->FindStop("Tolstopaltsevo"sv)->name.get_allocator().resource() == copy->GetMemoryResource(), true,
+                          "Имена копии размещены не в её арене."s);
+    }
+
+    void test::Sharded_router_matches_single_router(){
+        // Сетка 4 x 9 остановок: маршруты по строкам пересекают все шарды, кольца по столбцам лежат внутри шардов
+        constexpr size_t rows = 4;
+        constexpr size_t cols = 9;
+        const auto name = [](size_t row, size_t col) {
+            return "S"s + std::to_string(row) + "_"s + std::to_string(col);
+        };
+        std::vector<std::string> names;
+        transport_catalogue::TransportCatalogue catalogue;
+        for (size_t row = 0; row < rows; ++row) {
+            for (size_t col = 0; col < cols; ++col) {
+                names.push_back(name(row, col));
+                catalogue.AddStop({names.back(), {55.6 + 0.01 * row, 37.3 + 0.01 * col}});
+            }
+        }
+        const auto set_distance = [&catalogue, &name](size_t r1, size_t c1, size_t r2, size_t c2) {
+            catalogue.SetDistanceBetweenStop(name(r2, c2), catalogue.FindStop(name(r1, c1)),
+                                             static_cast<uint32_t>(300 + (r1 * 7 + c1 * 13 + r2 * 3) % 200));
+        };
+        for (size_t row = 0; row < rows; ++row) {
+            std::vector<std::string_view> route;
+            for (size_t col = 0; col < cols; ++col) {
+                route.push_back(names[row * cols + col]);
+                if (col + 1 < cols) {
+                    set_distance(row, col, row, col + 1);
+                    set_distance(row, col + 1, row, col);
+                }
+            }
+            // Чётные строки — некольцевые маршруты, нечётные — только в одну сторону
+            catalogue.AddBus("R"s + std::to_string(row), route, row % 2 == 1);
+        }
+        for (size_t col = 0; col < cols; col += 2) {
+            std::vector<std::string_view> route;
+            for (size_t row = 0; row < rows; ++row) {
+                route.push_back(names[row * cols + col]);
+                set_distance(row, col, (row + 1) % rows, col);
+            }
+            route.push_back(names[col]);
+            catalogue.AddBus("C"s + std::to_string(col), route, true);
+        }
+        catalogue.Freeze();
+
+        transport_router::RoutingSettings settings{4.0, 30.0};
+        transport_router::TransportRouter single(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        sharded_router::ShardedRouter sharded(settings, catalogue, 3);
+        ASSERT_EQUAL_HINT(sharded.GetShardCount(), 3u, "Не создано заданное число шардов."s);
+        ASSERT_EQUAL_HINT(sharded.GetBoundaryStopCount() > 0, true, "Нет граничных остановок у межшардовых маршрутов."s);
+
+        const auto total_time = [](const transport_router::EdgeDescriptions& route) {
+            double total = 0.0;
+            for (const auto& item : route) {
+                total += item.time_;
+            }
+            return total;
+        };
+        for (const std::string& from : names) {
+            for (const std::string& to : names) {
+                const auto expected = single.BuildRoute(from, to);
+                const auto actual = sharded.BuildRoute(from, to);
+                ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "Шардированный маршрутизатор не находит маршрут."s);
+                if (expected) {
+                    ASSERT_EQUAL_HINT(std::abs(total_time(*actual) - total_time(*expected)) < 1e-9, true,
+                                      "Шардированный маршрут длиннее оптимального: "s + from + " -> "s + to);
+                }
+            }
+        }
+    }
+
+    void test::Batch_distance_matches_scalar(){
+        std::vector<geo::Coordinates> points;
+        for (int i = 0; i < 23; ++i) {
+            points.push_back({55.5 + 0.013 * (i % 7), 37.2 + 0.029 * (i % 5) - 0.001 * i});
+        }
+        const geo::Coordinates center = {55.57, 37.31};
+
+        geo::CoordinatesBatch batch;
+        for (const auto& point : points) {
+            batch.Add(point);
+        }
+        std::vector<double> vectorized(points.size() - 1);
+        std::vector<double> scalar(points.size() - 1);
+        batch.ComputeCosines(center, 1, vectorized);
+        batch.ComputeCosinesScalar(center, 1, scalar);
+        for (size_t i = 0; i < scalar.size(); ++i) {
+            ASSERT_EQUAL_HINT(std::abs(vectorized[i] - scalar[i]) < 1e-15, true, "Пакетный расчёт расходится со скалярным."s);
+            const double expected = geo::CosineOfDistance(geo::ComputeDistance(center, points[i + 1]));
+            ASSERT_EQUAL_HINT(std::abs(scalar[i] - expected) < 1e-12, true, "Косинус угла не соответствует расстоянию."s);
+        }
+
+        const auto precomputed_center = geo::Precompute(center);
+        for (const auto& point : points) {
+            ASSERT_EQUAL_HINT(geo::ComputeDistance(precomputed_center, geo::Precompute(point)), geo::ComputeDistance(center, point),
+                              "Расстояние по заранее посчитанным синусам отличается от обычного."s);
+        }
+
+        // Отбор по косинусу в сетке не должен терять остановки по сравнению с полным перебором
+        transport_catalogue::TransportCatalogue sut;
+        for (size_t i = 0; i < points.size(); ++i) {
+            sut.AddStop({"P"s + std::to_string(i), points[i]});
+        }
+        sut.Freeze();
+        for (double radius : {0.0, 500.0, 1500.0, 4000.0}) {
+            size_t expected = 0;
+            for (const auto& point : points) {
+                expected += geo::ComputeDistance(center, point) <= radius ? 1 : 0;
+            }
+            ASSERT_EQUAL_HINT(sut.FindNearbyStops(center, radius, points.size()).size(), expected,
+                              "Поиск по сетке расходится с полным перебором."s);
+        }
+    }
+
+    void test::Approximate_distance_within_error_bound(){
+        const geo::Coordinates center = {55.75, 37.62};
+        std::vector<geo::Coordinates> points;
+        for (int i = 1; i <= 40; ++i) {
+            // До ~50 км в разных направлениях
+            points.push_back({center.lat + 0.011 * i * ((i % 3) - 1), center.lng + 0.0097 * i * ((i % 4) - 1.5)});
+        }
+        for (const auto& point : points) {
+            const double precise = geo::ComputeDistance(center, point, geo::DistanceMode::PRECISE);
+            const double approximate = geo::ComputeDistance(center, point, geo::DistanceMode::EQUIRECTANGULAR);
+            ASSERT_EQUAL_HINT(precise, geo::ComputeDistance(center, point), "Точный режим должен совпадать с ComputeDistance."s);
+            ASSERT_EQUAL_HINT(std::abs(approximate - precise) <= 3e-5 * precise + 1e-6, true,
+                              "Приближённое расстояние вне заявленной погрешности."s);
+        }
+
+        // Поиск с приближённым расстоянием находит те же остановки, что и точный, вдали от границы радиуса
+        transport_catalogue::TransportCatalogue sut;
+        for (size_t i = 0; i < points.size(); ++i) {
+            sut.AddStop({"P"s + std::to_string(i), points[i]});
+        }
+        sut.Freeze();
+        const auto precise = sut.FindNearbyStops(center, 20000.0, points.size());
+        const auto approximate = sut.FindNearbyStops(center, 20000.0, points.size(), geo::DistanceMode::EQUIRECTANGULAR);
+        ASSERT_EQUAL_HINT(approximate.size(), precise.size(), "Приближённый поиск нашёл другое число остановок."s);
+        for (size_t i = 0; i < precise.size(); ++i) {
+            ASSERT_EQUAL_HINT(approximate[i].stop, precise[i].stop, "Приближённый поиск изменил порядок остановок."s);
+        }
+    }
+
+    void test::Dijkstra_router_matches_floyd_warshall(){
+        // Граф с нулевыми рёбрами, параллельными рёбрами и недостижимой вершиной
+        constexpr size_t vertex_count = 12;
+        transport_router::GraphBuilder builder(vertex_count);
+        for (size_t i = 0; i + 1 < vertex_count; ++i) {
+            for (size_t step = 1; step <= 3 && i + step + 1 < vertex_count; ++step) {
+                builder.AddEdge({i, i + step, static_cast<double>((i * 7 + step * 5) % 11)});
+            }
+            builder.AddEdge({i + 1, i / 2, static_cast<double>((i * 3) % 4)});
+        }
+        builder.AddEdge({0, 1, 0.5});
+        const transport_router::Graph graph = builder.Build();
+
+        const transport_router::Router floyd_warshall(graph);
+        const graph::DijkstraRouter<double> dijkstra(graph);
+        for (graph::VertexId from = 0; from < vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                const auto expected = floyd_warshall.BuildRoute(from, to);
+                const auto actual = dijkstra.BuildRoute(from, to);
+                ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "Дейкстра расходится с Флойдом–Уоршеллом в достижимости."s);
+                if (!actual) {
+                    continue;
+                }
+                ASSERT_EQUAL_HINT(actual->weight, expected->weight, "Дейкстра нашёл путь другой длины."s);
+                double weight = 0.0;
+                graph::VertexId vertex = from;
+                for (graph::EdgeId edge_id : actual->edges) {
+                    ASSERT_EQUAL_HINT(graph.GetEdge(edge_id).from, vertex, "Рёбра пути Дейкстры не образуют цепочку."s);
+                    vertex = graph.GetEdge(edge_id).to;
+                    weight += graph.GetEdge(edge_id).weight;
+                }
+                ASSERT_EQUAL_HINT(vertex, to, "Путь Дейкстры заканчивается не в той вершине."s);
+                ASSERT_EQUAL_HINT(weight, actual->weight, "Вес пути Дейкстры не равен сумме весов рёбер."s);
+            }
+        }
+
+        // Прямое и обратное деревья кратчайших путей дают те же веса
+        using Direction = graph::ShortestPathTree<double>::Direction;
+        for (graph::VertexId root = 0; root < vertex_count; ++root) {
+            const auto forward = dijkstra.BuildTree(root, Direction::FORWARD);
+            const auto backward = dijkstra.BuildTree(root, Direction::BACKWARD);
+            for (graph::VertexId other = 0; other < vertex_count; ++other) {
+                const auto from_root = floyd_warshall.BuildRoute(root, other);
+                const auto to_root = floyd_warshall.BuildRoute(other, root);
+                const auto forward_route = forward.BuildRoute(graph, other);
+                const auto backward_route = backward.BuildRoute(graph, other);
+                ASSERT_EQUAL_HINT(forward_route.has_value(), from_root.has_value(), "Прямое дерево расходится в достижимости."s);
+                ASSERT_EQUAL_HINT(backward_route.has_value(), to_root.has_value(), "Обратное дерево расходится в достижимости."s);
+                if (from_root) {
+                    ASSERT_EQUAL_HINT(forward_route->weight, from_root->weight, "Прямое дерево дало путь другой длины."s);
+                    ASSERT_EQUAL_HINT(forward_route->edges.empty() || graph.GetEdge(forward_route->edges.front()).from == root, true,
+                                      "Путь из прямого дерева начинается не в корне."s);
+                }
+                if (to_root) {
+                    ASSERT_EQUAL_HINT(backward_route->weight, to_root->weight, "Обратное дерево дало путь другой длины."s);
+                    ASSERT_EQUAL_HINT(backward_route->edges.empty() || graph.GetEdge(backward_route->edges.back()).to == root, true,
+                                      "Путь из обратного дерева заканчивается не в корне."s);
+                }
+            }
+        }
+    }
+
+    void test::Route_cache_evicts_least_recently_used(){
+        struct Identity {
+            size_t operator()(int value) const {
+                return static_cast<size_t>(value);
+            }
+        };
+        struct NoPayload {
+            size_t operator()(int) const {
+                return 0;
+            }
+        };
+        using Cache = lru_cache::ShardedLruCache<int, int, Identity, NoPayload>;
+        // Один шард ровно на две записи
+        Cache probe(1 << 20, 1);
+        probe.Put(0, 0);
+        Cache cache(probe.GetStats().bytes * 2, 1);
+
+        cache.Put(1, 10);
+        cache.Put(2, 20);
+        ASSERT_EQUAL_HINT(cache.Get(1).value_or(-1), 10, "Кэш потерял запись."s);
+        cache.Put(3, 30); // Вытесняет 2: к 1 обращались позже
+        ASSERT_EQUAL_HINT(cache.Get(2).has_value(), false, "Кэш вытеснил не самую старую запись."s);
+        ASSERT_EQUAL_HINT(cache.Get(1).value_or(-1), 10, "Кэш вытеснил недавно прочитанную запись."s);
+        ASSERT_EQUAL_HINT(cache.Get(3).value_or(-1), 30, "Кэш не сохранил новую запись."s);
+
+        auto stats = cache.GetStats();
+        ASSERT_EQUAL_HINT(stats.hits, 3u, "Неверное число попаданий."s);
+        ASSERT_EQUAL_HINT(stats.misses, 1u, "Неверное число промахов."s);
+        ASSERT_EQUAL_HINT(stats.evictions, 1u, "Неверное число вытеснений."s);
+        ASSERT_EQUAL_HINT(stats.entries, 2u, "Кэш превысил ёмкость."s);
+        cache.Clear();
+        ASSERT_EQUAL_HINT(cache.GetStats().bytes, 0u, "Очистка кэша не освободила память."s);
+
+        // Маршрутизатор с кэшем отвечает так же, как без него, и повторный запрос берёт из кэша
+        transport_catalogue::TransportCatalogue catalogue;
+        catalogue.AddStop({"A"s, {55.60, 37.20}});
+        catalogue.AddStop({"B"s, {55.61, 37.21}});
+        catalogue.AddStop({"C"s, {55.62, 37.22}});
+        catalogue.SetDistanceBetweenStop("B"sv, catalogue.FindStop("A"sv), 1000);
+        catalogue.SetDistanceBetweenStop("C"sv, catalogue.FindStop("B"sv), 2000);
+        catalogue.AddBus("1"s, {"A"sv, "B"sv, "C"sv}, false);
+        catalogue.Freeze();
+        const transport_router::TransportRouter plain({6.0, 40.0},
+                std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        const transport_router::TransportRouter cached({6.0, 40.0, 1, transport_router::RouterEngine::DIJKSTRA, 1 << 16},
+                std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        for (int pass = 0; pass < 2; ++pass) {
+            for (std::string_view from : {"A"sv, "B"sv, "C"sv}) {
+                for (std::string_view to : {"A"sv, "B"sv, "C"sv}) {
+                    const auto expected = plain.BuildRoute(from, to);
+                    const auto actual = cached.BuildRoute(from, to);
+                    ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "Кэш изменил достижимость."s);
+                    if (expected) {
+                        ASSERT_EQUAL_HINT(actual->size(), expected->size(), "Кэш изменил маршрут."s);
+                    }
+                }
+            }
+        }
+        stats = cached.GetRouteCacheStats();
+        ASSERT_EQUAL_HINT(stats.misses, 6u, "Первый проход должен промахнуться по каждой паре разных остановок."s);
+        ASSERT_EQUAL_HINT(stats.hits, 6u, "Второй проход должен взять все маршруты из кэша."s);
+    }
+
+    void test::Route_batch_reuses_shortest_path_trees(){
+        // Кольцо A > B > C > D > A и встречный маршрут D - E
+        transport_catalogue::TransportCatalogue catalogue;
+        const std::vector<std::string> names = {"A"s, "B"s, "C"s, "D"s, "E"s};
+        for (size_t i = 0; i < names.size(); ++i) {
+            catalogue.AddStop({names[i], {55.60 + 0.01 * i, 37.20}});
+        }
+        for (size_t i = 0; i < 4; ++i) {
+            catalogue.SetDistanceBetweenStop(names[(i + 1) % 4], catalogue.FindStop(names[i]), static_cast<uint32_t>(1000 * (i + 1)));
+        }
+        catalogue.SetDistanceBetweenStop("E"sv, catalogue.FindStop("D"sv), 700);
+        catalogue.AddBus("ring"s, {"A"sv, "B"sv, "C"sv, "D"sv, "A"sv}, true);
+        catalogue.AddBus("line"s, {"D"sv, "E"sv}, false);
+        catalogue.Freeze();
+
+        const transport_router::TransportRouter plain({6.0, 40.0},
+                std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        transport_router::RoutingSettings settings{6.0, 40.0, 1, transport_router::RouterEngine::DIJKSTRA};
+        settings.tree_cache_bytes_ = 1 << 20;
+        const transport_router::TransportRouter trees(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+
+        // Три запроса из A, три запроса в E, одиночный запрос и запросы без ответа
+        const std::vector<transport_router::RouteQuery> queries = {
+            {"A"sv, "B"sv}, {"B"sv, "E"sv}, {"A"sv, "D"sv}, {"C"sv, "E"sv}, {"A"sv, "E"sv},
+            {"D"sv, "E"sv}, {"E"sv, "C"sv}, {"C"sv, "C"sv}, {"A"sv, "Z"sv}
+        };
+        const auto total_time = [](const transport_router::EdgeDescriptions& route) {
+            double total = 0.0;
+            for (const auto& item : route) {
+                total += item.time_;
+            }
+            return total;
+        };
+        const auto routes = trees.BuildRoutes(queries);
+        ASSERT_EQUAL_HINT(routes.size(), queries.size(), "Ответов должно быть столько же, сколько запросов."s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = plain.BuildRoute(queries[i].first, queries[i].second);
+            ASSERT_EQUAL_HINT(routes[i].has_value(), expected.has_value(), "Маршрут из дерева расходится в достижимости."s);
+            if (expected) {
+                ASSERT_EQUAL_HINT(std::abs(total_time(*routes[i]) - total_time(*expected)) < 1e-9, true,
+                                  "Маршрут из дерева длиннее оптимального."s);
+            }
+        }
+        // Одно прямое дерево из A и одно обратное в E; A -> E входит в группу A, у неё больше запросов
+        ASSERT_EQUAL_HINT(trees.GetTreeCacheStats().entries, 2u, "Для пачки должно строиться по дереву на группу."s);
+
+        // Одиночный запрос из A берётся из уже построенного дерева
+        const auto hits = trees.GetTreeCacheStats().hits;
+        trees.BuildRoute("A"sv, "C"sv);
+        ASSERT_EQUAL_HINT(trees.GetTreeCacheStats().hits, hits + 1, "Одиночный запрос не использовал дерево из кэша."s);
+    }
+
+    void test::Contraction_hierarchy_matches_floyd_warshall(){
+        // Псевдослучайный граф с параллельными рёбрами, петлями и нулевыми весами
+        constexpr size_t vertex_count = 60;
+        transport_router::GraphBuilder builder(vertex_count);
+        uint32_t state = 12345;
+        const auto next = [&state]() {
+            state = state * 1103515245u + 12345u;
+            return (state >> 16) & 0x7FFF;
+        };
+        for (size_t i = 0; i < vertex_count * 4; ++i) {
+            const graph::VertexId from = next() % vertex_count;
+            const graph::VertexId to = next() % vertex_count;
+            builder.AddEdge({from, to, static_cast<double>(next() % 20)});
+        }
+        const transport_router::Graph graph = builder.Build();
+
+        const transport_router::Router floyd_warshall(graph);
+        const graph::ContractionHierarchyRouter<double> hierarchy(graph);
+        for (graph::VertexId from = 0; from < vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                const auto expected = floyd_warshall.BuildRoute(from, to);
+                const auto actual = hierarchy.BuildRoute(from, to);
+                ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "Иерархия сжатий расходится в достижимости."s);
+                if (!actual) {
+                    continue;
+                }
+                ASSERT_EQUAL_HINT(actual->weight, expected->weight, "Иерархия сжатий нашла путь другой длины."s);
+                // Сокращения должны раскрываться в цепочку исходных рёбер
+                double weight = 0.0;
+                graph::VertexId vertex = from;
+                for (graph::EdgeId edge_id : actual->edges) {
+                    ASSERT_EQUAL_HINT(graph.GetEdge(edge_id).from, vertex, "Раскрытый путь не образует цепочку."s);
+                    vertex = graph.GetEdge(edge_id).to;
+                    weight += graph.GetEdge(edge_id).weight;
+                }
+                ASSERT_EQUAL_HINT(vertex, to, "Раскрытый путь заканчивается не в той вершине."s);
+                ASSERT_EQUAL_HINT(weight, actual->weight, "Вес раскрытого пути не равен сумме весов рёбер."s);
+            }
+        }
+    }
+
+    void test::A_star_matches_dijkstra_with_fewer_settled_vertices(){
+        // Сетка с шагом около 300 метров и дорогами 250–450 метров: часть дорог короче прямой
+        transport_catalogue::TransportCatalogue catalogue;
+        benchmark::FillSyntheticNetwork(catalogue, {400, 60, 20, 7});
+        const std::vector<std::string_view> stops = catalogue.GetUsedStopNames();
+
+        transport_router::RoutingSettings settings{6.0, 40.0, 1, transport_router::RouterEngine::DIJKSTRA};
+        const transport_router::TransportRouter dijkstra(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        settings.router_engine_ = transport_router::RouterEngine::A_STAR;
+        const transport_router::TransportRouter a_star(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+
+        const auto total_time = [](const transport_router::EdgeDescriptions& route) {
+            double total = 0.0;
+            for (const auto& item : route) {
+                total += item.time_;
+            }
+            return total;
+        };
+        for (size_t i = 0; i < 500; ++i) {
+            const std::string_view from = stops[(i * 7919) % stops.size()];
+            const std::string_view to = stops[(i * 104729 + 13) % stops.size()];
+            const auto expected = dijkstra.BuildRoute(from, to);
+            const auto actual = a_star.BuildRoute(from, to);
+            ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "A* расходится с Дейкстрой в достижимости."s);
+            if (expected) {
+                ASSERT_EQUAL_HINT(std::abs(total_time(*actual) - total_time(*expected)) < 1e-9, true,
+                                  "A* нашёл маршрут другой длительности."s);
+            }
+        }
+        ASSERT_EQUAL_HINT(a_star.GetSettledVertexCount() < dijkstra.GetSettledVertexCount(), true,
+                          "Оценка по прямой должна сокращать число извлечённых вершин."s);
+    }
+
+    void test::Bidirectional_dijkstra_matches_floyd_warshall(){
+        // Псевдослучайный граф с параллельными рёбрами, петлями и нулевыми весами
+        constexpr size_t vertex_count = 60;
+        transport_router::GraphBuilder builder(vertex_count);
+        uint32_t state = 777;
+        const auto next = [&state]() {
+            state = state * 1103515245u + 12345u;
+            return (state >> 16) & 0x7FFF;
+        };
+        for (size_t i = 0; i < vertex_count * 3; ++i) {
+            const graph::VertexId from = next() % vertex_count;
+            const graph::VertexId to = next() % vertex_count;
+            builder.AddEdge({from, to, static_cast<double>(next() % 20)});
+        }
+        const transport_router::Graph graph = builder.Build();
+        size_t incoming = 0;
+        for (graph::VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            for (graph::EdgeId edge_id : graph.GetIncomingEdges(vertex)) {
+                ASSERT_EQUAL_HINT(graph.GetEdge(edge_id).to, vertex, "Входящее ребро ведёт не в эту вершину."s);
+                ++incoming;
+            }
+        }
+        ASSERT_EQUAL_HINT(incoming, graph.GetEdgeCount(), "Каждое ребро должно быть входящим ровно у одной вершины."s);
+
+        const transport_router::Router floyd_warshall(graph);
+        const graph::BidirectionalDijkstraRouter<double> bidirectional(graph);
+        for (graph::VertexId from = 0; from < vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                const auto expected = floyd_warshall.BuildRoute(from, to);
+                const auto actual = bidirectional.BuildRoute(from, to);
+                ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "Двунаправленная Дейкстра расходится в достижимости."s);
+                if (!actual) {
+                    continue;
+                }
+                ASSERT_EQUAL_HINT(actual->weight, expected->weight, "Двунаправленная Дейкстра нашла путь другой длины."s);
+                double weight = 0.0;
+                graph::VertexId vertex = from;
+                for (graph::EdgeId edge_id : actual->edges) {
+                    ASSERT_EQUAL_HINT(graph.GetEdge(edge_id).from, vertex, "Склеенный путь не образует цепочку."s);
+                    vertex = graph.GetEdge(edge_id).to;
+                    weight += graph.GetEdge(edge_id).weight;
+                }
+                ASSERT_EQUAL_HINT(vertex, to, "Склеенный путь заканчивается не в той вершине."s);
+                ASSERT_EQUAL_HINT(weight, actual->weight, "Вес склеенного пути не равен сумме весов рёбер."s);
+            }
+        }
+
+        // На сетке встречные поиски извлекают меньше вершин, чем один прямой
+        transport_catalogue::TransportCatalogue catalogue;
+        benchmark::FillSyntheticNetwork(catalogue, {400, 60, 20, 7});
+        const std::vector<std::string_view> stops = catalogue.GetUsedStopNames();
+        transport_router::RoutingSettings settings{6.0, 40.0, 1, transport_router::RouterEngine::DIJKSTRA};
+        const transport_router::TransportRouter dijkstra(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        settings.router_engine_ = transport_router::RouterEngine::BIDIRECTIONAL_DIJKSTRA;
+        const transport_router::TransportRouter two_way(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        for (size_t i = 0; i < 200; ++i) {
+            dijkstra.BuildRoute(stops[(i * 7919) % stops.size()], stops[(i * 104729 + 13) % stops.size()]);
+            two_way.BuildRoute(stops[(i * 7919) % stops.size()], stops[(i * 104729 + 13) % stops.size()]);
+        }
+        ASSERT_EQUAL_HINT(two_way.GetSettledVertexCount() < dijkstra.GetSettledVertexCount(), true,
+                          "Двунаправленный поиск должен извлекать меньше вершин."s);
+    }
+
+    void test::Graph_builder_lays_out_edges_by_vertex(){
+        // Рёбра добавляются вперемешку по исходящим вершинам
+        const std::vector<graph::Edge<double>> added = {
+            {2, 0, 1.0}, {0, 1, 2.0}, {2, 1, 3.0}, {1, 2, 4.0}, {0, 2, 5.0}, {0, 0, 6.0}
+        };
+        transport_router::GraphBuilder builder(4);
+        std::vector<std::string> names;
+        for (size_t i = 0; i < added.size(); ++i) {
+            ASSERT_EQUAL_HINT(builder.AddEdge(added[i]), i, "AddEdge должен возвращать номер добавления."s);
+            names.push_back("edge "s + std::to_string(i));
+        }
+        const transport_router::Graph graph = builder.Build();
+        ASSERT_EQUAL_HINT(graph.GetVertexCount(), 4u, "Число вершин задаётся построителю."s);
+        ASSERT_EQUAL_HINT(graph.GetEdgeCount(), added.size(), "В графе должны быть все добавленные рёбра."s);
+
+        for (size_t i = 0; i < added.size(); ++i) {
+            const auto edge = graph.GetEdge(builder.GetEdgeId(i));
+            ASSERT_EQUAL_HINT(edge.from, added[i].from, "GetEdgeId указывает на другое ребро."s);
+            ASSERT_EQUAL_HINT(edge.to, added[i].to, "GetEdgeId указывает на другое ребро."s);
+            ASSERT_EQUAL_HINT(edge.weight, added[i].weight, "GetEdgeId указывает на другое ребро."s);
+        }
+        // Исходящие рёбра вершины идут подряд и в порядке добавления
+        std::vector<double> weights;
+        for (graph::EdgeId edge_id : graph.GetIncidentEdges(0)) {
+            weights.push_back(graph.GetEdge(edge_id).weight);
+        }
+        ASSERT_EQUAL_HINT(weights == (std::vector<double>{2.0, 5.0, 6.0}), true, "Нарушен порядок исходящих рёбер."s);
+        ASSERT_EQUAL_HINT(graph.GetIncidentEdges(3).empty(), true, "У вершины без рёбер не должно быть исходящих."s);
+        std::vector<graph::VertexId> sources;
+        for (graph::EdgeId edge_id : graph.GetIncomingEdges(1)) {
+            sources.push_back(graph.GetEdge(edge_id).from);
+        }
+        ASSERT_EQUAL_HINT(sources == (std::vector<graph::VertexId>{0, 2}), true, "Входящие рёбра найдены неверно."s);
+
+        const std::vector<std::string> ordered = builder.Reorder(std::move(names));
+        for (size_t i = 0; i < added.size(); ++i) {
+            ASSERT_EQUAL_HINT(ordered[builder.GetEdgeId(i)], "edge "s + std::to_string(i), "Reorder переставил данные не по id рёбер."s);
+        }
+    }
+
+    void test::Route_line_model_matches_stop_pairs(){
+        transport_catalogue::TransportCatalogue catalogue;
+        benchmark::FillSyntheticNetwork(catalogue, {400, 60, 20, 7});
+        const std::vector<std::string_view> stops = catalogue.GetUsedStopNames();
+
+        transport_router::RoutingSettings settings{6.0, 40.0, 1, transport_router::RouterEngine::DIJKSTRA};
+        const transport_router::TransportRouter stop_pairs(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        settings.graph_model_ = transport_router::GraphModel::ROUTE_LINES;
+        const transport_router::TransportRouter route_lines(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        ASSERT_EQUAL_HINT(route_lines.GetGraphMemoryUsage() < stop_pairs.GetGraphMemoryUsage(), true,
+                          "Граф с вершинами на позициях маршрутов должен быть меньше."s);
+
+        const auto total_time = [](const transport_router::EdgeDescriptions& route) {
+            double total = 0.0;
+            for (const auto& item : route) {
+                total += item.time_;
+            }
+            return total;
+        };
+        for (size_t i = 0; i < 300; ++i) {
+            const std::string_view from = stops[(i * 7919) % stops.size()];
+            const std::string_view to = stops[(i * 104729 + 13) % stops.size()];
+            const auto expected = stop_pairs.BuildRoute(from, to);
+            const auto actual = route_lines.BuildRoute(from, to);
+            ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "Модели графа расходятся в достижимости."s);
+            if (!expected) {
+                continue;
+            }
+            ASSERT_EQUAL_HINT(std::abs(total_time(*actual) - total_time(*expected)) < 1e-9, true,
+                              "Модели графа дают маршруты разной длительности."s);
+            // Поездки по перегонам склеены: ожидание и поездка чередуются, выходов в ответе нет
+            for (size_t item = 0; item < actual->size(); ++item) {
+                const auto expected_type = item % 2 == 0 ? transport_router::EdgeType::WAIT : transport_router::EdgeType::BUS;
+                ASSERT_EQUAL_HINT((*actual)[item].type_ == expected_type, true, "Поездки не склеены в одну."s);
+            }
+            if (!actual->empty()) {
+                ASSERT_EQUAL_HINT((*actual)[0].edge_name_, from, "Маршрут должен начинаться ожиданием на остановке отправления."s);
+            }
+        }
+    }
+
+    void test::Raptor_matches_dijkstra_and_lists_pareto_routes(){
+        transport_catalogue::TransportCatalogue catalogue;
+        benchmark::FillSyntheticNetwork(catalogue, {400, 60, 20, 7});
+        const std::vector<std::string_view> stops = catalogue.GetUsedStopNames();
+
+        transport_router::RoutingSettings settings{6.0, 40.0, 1, transport_router::RouterEngine::DIJKSTRA};
+        const transport_router::TransportRouter dijkstra(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        settings.router_engine_ = transport_router::RouterEngine::RAPTOR;
+        const transport_router::TransportRouter raptor_engine(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        ASSERT_EQUAL_HINT(raptor_engine.GetGraphMemoryUsage(), 0u, "RAPTOR не должен строить граф."s);
+        const raptor::RaptorRouter pareto(catalogue, settings);
+
+        const auto total_time = [](const transport_router::EdgeDescriptions& route) {
+            double total = 0.0;
+            for (const auto& item : route) {
+                total += item.time_;
+            }
+            return total;
+        };
+        for (size_t i = 0; i < 300; ++i) {
+            const std::string_view from = stops[(i * 7919) % stops.size()];
+            const std::string_view to = stops[(i * 104729 + 13) % stops.size()];
+            const auto expected = dijkstra.BuildRoute(from, to);
+            const auto actual = raptor_engine.BuildRoute(from, to);
+            ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "RAPTOR и Дейкстра расходятся в достижимости."s);
+            if (!expected) {
+                continue;
+            }
+            ASSERT_EQUAL_HINT(std::abs(total_time(*actual) - total_time(*expected)) < 1e-9, true,
+                              "RAPTOR нашёл маршрут другой длительности."s);
+            if (!actual->empty()) {
+                ASSERT_EQUAL_HINT((*actual)[0].edge_name_, from, "Маршрут должен начинаться ожиданием на остановке отправления."s);
+            }
+
+            // Каждый следующий маршрут Парето-множества строго быстрее и с большим числом поездок
+            const auto routes = pareto.BuildParetoRoutes(catalogue.FindStop(from), catalogue.FindStop(to));
+            ASSERT_EQUAL_HINT(routes.empty(), false, "У достижимой пары должен быть хотя бы один маршрут."s);
+            for (size_t k = 1; k < routes.size(); ++k) {
+                ASSERT_EQUAL_HINT(total_time(routes[k]) < total_time(routes[k - 1]), true,
+                                  "Маршрут с большим числом поездок должен быть быстрее."s);
+                ASSERT_EQUAL_HINT(routes[k].size() > routes[k - 1].size(), true,
+                                  "Маршруты должны идти по возрастанию числа поездок."s);
+            }
+            ASSERT_EQUAL_HINT(std::abs(total_time(routes.back()) - total_time(*expected)) < 1e-9, true,
+                              "Последний маршрут Парето-множества должен быть самым быстрым."s);
+        }
+        ASSERT_EQUAL_HINT(raptor_engine.GetSettledVertexCount() > 0u, true, "Должны учитываться просмотренные позиции."s);
+    }
+
+    void test::Blocked_floyd_warshall_matches_triple_loop(){
+        // Несколько блоков, последний неполный; целые веса дают много путей равной длины
+        constexpr size_t vertex_count = 150;
+        transport_router::GraphBuilder builder(vertex_count);
+        for (size_t i = 0; i + 10 < vertex_count; ++i) {
+            for (size_t step : {1, 7, 31}) {
+                builder.AddEdge({i, (i + step) % (vertex_count - 10), static_cast<double>((i * 13 + step) % 5)});
+            }
+        }
+        const transport_router::Graph graph = builder.Build();
+        const transport_router::Router floyd_warshall(graph);
+        // Потоков больше, чем ядер: порядок блоков меняется, ответы — нет
+        const transport_router::Router floyd_warshall_threads(graph, 4);
+
+        // Простой тройной цикл: вес и последнее ребро пути, std::nullopt — пути нет
+        using Cell = std::optional<std::pair<double, std::optional<graph::EdgeId>>>;
+        std::vector<std::vector<Cell>> expected(vertex_count, std::vector<Cell>(vertex_count));
+        for (graph::VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            expected[vertex][vertex] = std::pair{0.0, std::optional<graph::EdgeId>{}};
+            for (const graph::EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+                const auto edge = graph.GetEdge(edge_id);
+                if (!expected[vertex][edge.to] || expected[vertex][edge.to]->first > edge.weight) {
+                    expected[vertex][edge.to] = std::pair{edge.weight, std::optional(edge_id)};
+                }
+            }
+        }
+        for (graph::VertexId through = 0; through < vertex_count; ++through) {
+            for (graph::VertexId from = 0; from < vertex_count; ++from) {
+                for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                    const Cell& head = expected[from][through];
+                    const Cell& tail = expected[through][to];
+                    if (head && tail && (!expected[from][to] || head->first + tail->first < expected[from][to]->first)) {
+                        expected[from][to] = std::pair{head->first + tail->first, tail->second ? tail->second : head->second};
+                    }
+                }
+            }
+        }
+
+        for (graph::VertexId from = 0; from < vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                const auto actual = floyd_warshall.BuildRoute(from, to);
+                ASSERT_EQUAL_HINT(actual.has_value(), expected[from][to].has_value(), "Блочный обход изменил достижимость."s);
+                if (!actual) {
+                    continue;
+                }
+                ASSERT_EQUAL_HINT(actual->weight, expected[from][to]->first, "Блочный обход нашёл путь другой длины."s);
+                // Среди путей равной длины выбирается тот же, что у тройного цикла
+                const std::optional<graph::EdgeId> last = actual->edges.empty() ? std::nullopt : std::optional(actual->edges.back());
+                ASSERT_EQUAL_HINT(last == expected[from][to]->second, true, "Блочный обход выбрал другой путь из равных."s);
+                ASSERT_EQUAL_HINT(floyd_warshall_threads.BuildRoute(from, to)->edges == actual->edges, true,
+                                  "Число потоков изменило выбор пути."s);
+            }
+        }
+
+        // Векторная релаксация строки совпадает со скалярной, включая бесконечности и равные веса
+        constexpr size_t row_size = 23;
+        std::vector<double> row_weights(row_size);
+        std::vector<uint32_t> row_edges(row_size);
+        std::vector<double> weights(row_size);
+        std::vector<uint32_t> edges(row_size);
+        for (size_t i = 0; i < row_size; ++i) {
+            row_weights[i] = i % 5 == 0 ? std::numeric_limits<double>::infinity() : static_cast<double>(i % 4);
+            row_edges[i] = static_cast<uint32_t>(100 + i);
+            weights[i] = i % 3 == 0 ? std::numeric_limits<double>::infinity() : static_cast<double>(i % 6);
+            edges[i] = static_cast<uint32_t>(i);
+        }
+        std::vector<double> scalar_weights = weights;
+        std::vector<uint32_t> scalar_edges = edges;
+        min_plus::RelaxRow(1.0, row_weights.data(), row_edges.data(), weights.data(), edges.data(), row_size);
+        min_plus::RelaxRowScalar(1.0, row_weights.data(), row_edges.data(), scalar_weights.data(), scalar_edges.data(), row_size);
+        ASSERT_EQUAL_HINT(weights == scalar_weights && edges == scalar_edges, true, "Векторная релаксация строки расходится со скалярной."s);
+    }
+
+    void test::Floyd_warshall_narrows_edge_ids_for_small_graphs(){
+        // Одинаковые графы-кольца, во втором кроме кольца ещё 70000 параллельных рёбер-дублей потяжелее
+        constexpr size_t vertex_count = 40;
+        const auto make_ring = [](transport_router::GraphBuilder& builder) {
+            for (size_t i = 0; i < vertex_count; ++i) {
+                builder.AddEdge({i, (i + 1) % vertex_count, 1.0 + static_cast<double>(i % 3)});
+            }
+        };
+        transport_router::GraphBuilder small_builder(vertex_count);
+        make_ring(small_builder);
+        transport_router::GraphBuilder large_builder(vertex_count);
+        make_ring(large_builder);
+        for (size_t i = 0; i < 70000; ++i) {
+            large_builder.AddEdge({i % vertex_count, (i + 1) % vertex_count, 10.0});
+        }
+        const transport_router::Graph small_graph = small_builder.Build();
+        const transport_router::Graph large_graph = large_builder.Build();
+        const transport_router::Router small(small_graph);
+        const transport_router::Router large(large_graph);
+        ASSERT_EQUAL_HINT(small.GetMemoryUsage(), vertex_count * vertex_count * sizeof(uint16_t),
+                          "У графа меньше чем из 65535 рёбер номера рёбер должны быть 16-битными."s);
+        ASSERT_EQUAL_HINT(large.GetMemoryUsage(), vertex_count * vertex_count * sizeof(uint32_t),
+                          "У большого графа номера рёбер должны быть 32-битными."s);
+
+        for (graph::VertexId from = 0; from < vertex_count; ++from) {
+            for (graph::VertexId to = 0; to < vertex_count; ++to) {
+                const auto expected = small.BuildRoute(from, to);
+                const auto actual = large.BuildRoute(from, to);
+                ASSERT_EQUAL_HINT(actual.has_value() && expected.has_value(), true, "На кольце достижимы все пары."s);
+                ASSERT_EQUAL_HINT(actual->weight, expected->weight, "Тяжёлые дубли не должны менять кратчайший путь."s);
+                ASSERT_EQUAL_HINT(actual->edges.size(), expected->edges.size(), "Тяжёлые дубли не должны менять кратчайший путь."s);
+                double weight = 0.0;
+                for (const graph::EdgeId edge_id : actual->edges) {
+                    weight += large_graph.GetEdge(edge_id).weight;
+                }
+                ASSERT_EQUAL_HINT(weight, actual->weight, "Вес пути должен быть суммой весов его рёбер."s);
+            }
+        }
+    }
+
+    void test::Router_state_round_trip(){
+        transport_catalogue::TransportCatalogue catalogue;
+        benchmark::FillSyntheticNetwork(catalogue, {200, 40, 12, 7});
+        const std::vector<std::string_view> stops = catalogue.GetUsedStopNames();
+
+        for (const auto engine : {transport_router::RouterEngine::FLOYD_WARSHALL, transport_router::RouterEngine::CONTRACTION_HIERARCHIES}) {
+            const transport_router::RoutingSettings settings{6.0, 40.0, 1, engine};
+            const transport_router::TransportRouter built(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+            std::stringstream stream;
+            serialization::SerializeRouterState(built, catalogue, stream);
+
+            // Состояние читается в копию справочника, которой будет владеть маршрутизатор
+            auto copy = std::make_unique<transport_catalogue::TransportCatalogue>(catalogue);
+            auto state = serialization::DeserializeRouterState(stream, *copy, settings);
+            ASSERT_EQUAL_HINT(state.routes.has_value(), engine == transport_router::RouterEngine::FLOYD_WARSHALL,
+                              "Матрица путей сохраняется только у Флойда–Уоршелла."s);
+            const transport_router::TransportRouter loaded(settings, std::move(copy), std::move(state));
+            ASSERT_EQUAL_HINT(loaded.GetGraphMemoryUsage(), built.GetGraphMemoryUsage(), "Граф не восстановился из состояния."s);
+
+            for (size_t i = 0; i < 200; ++i) {
+                const std::string_view from = stops[(i * 7919) % stops.size()];
+                const std::string_view to = stops[(i * 104729 + 13) % stops.size()];
+                const auto expected = built.BuildRoute(from, to);
+                const auto actual = loaded.BuildRoute(from, to);
+                ASSERT_EQUAL_HINT(actual.has_value(), expected.has_value(), "Загруженный маршрутизатор расходится в достижимости."s);
+                if (!expected) {
+                    continue;
+                }
+                ASSERT_EQUAL_HINT(actual->size(), expected->size(), "Загруженный маршрутизатор нашёл другой маршрут."s);
+                for (size_t item = 0; item < actual->size(); ++item) {
+                    ASSERT_EQUAL_HINT((*actual)[item].edge_name_, (*expected)[item].edge_name_, "Загруженный маршрутизатор нашёл другой маршрут."s);
+                    ASSERT_EQUAL_HINT((*actual)[item].time_, (*expected)[item].time_, "Время участка не восстановилось."s);
+                    ASSERT_EQUAL_HINT((*actual)[item].span_count_ == (*expected)[item].span_count_, true, "Число пролётов не восстановилось."s);
+                }
+            }
+        }
+
+        // Состояние привязано к справочнику и к настройкам, от которых зависит граф
+        const transport_router::RoutingSettings settings{6.0, 40.0};
+        const transport_router::TransportRouter built(settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue));
+        std::stringstream stream;
+        serialization::SerializeRouterState(built, catalogue, stream);
+        const std::string saved = stream.str();
+
+        transport_catalogue::TransportCatalogue other;
+        benchmark::FillSyntheticNetwork(other, {200, 40, 12, 8});
+        bool refused = false;
+        try {
+            std::istringstream input(saved);
+            serialization::DeserializeRouterState(input, other, settings);
+        } catch (const serialization::SerializationError&) {
+            refused = true;
+        }
+        ASSERT_EQUAL_HINT(refused, true, "Состояние другого справочника не должно загружаться."s);
+
+        refused = false;
+        try {
+            std::istringstream input(saved);
+            serialization::DeserializeRouterState(input, catalogue, {7.0, 40.0});
+        } catch (const serialization::SerializationError&) {
+            refused = true;
+        }
+        ASSERT_EQUAL_HINT(refused, true, "Состояние с другими настройками маршрутизации не должно загружаться."s);
+
+        // Без матрицы путей файл кончается номером остановки последней вершины и нулевым флагом матрицы:
+        // номер заменяется несуществующим, хэш справочника и настройки при этом остаются верными
+        const transport_router::RoutingSettings ch_settings{6.0, 40.0, 1, transport_router::RouterEngine::CONTRACTION_HIERARCHIES};
+        std::stringstream ch_stream;
+        serialization::SerializeRouterState(transport_router::TransportRouter(ch_settings, std::make_unique<transport_catalogue::TransportCatalogue>(catalogue)),
+                                            catalogue, ch_stream);
+        std::string corrupted = ch_stream.str();
+        size_t last_stop = corrupted.size() - 2;
+        while (static_cast<unsigned char>(corrupted[last_stop - 1]) & 0x80) {
+            --last_stop;
+        }
+        const uint64_t missing_stop = catalogue.GetStopCount() + 1000;
+        corrupted.replace(last_stop, corrupted.size() - 1 - last_stop,
+                          {static_cast<char>((missing_stop & 0x7F) | 0x80), static_cast<char>(missing_stop >> 7)});
+        refused = false;
+        try {
+            std::istringstream input(corrupted);
+            serialization::DeserializeRouterState(input, catalogue, ch_settings);
+        } catch (const serialization::SerializationError&) {
+            refused = true;
+        }
+        ASSERT_EQUAL_HINT(refused, true, "Состояние с вершиной несуществующей остановки не должно загружаться."s);
+
+        // Первое ребро начинается после заголовка (сигнатура, версия, хэш, две настройки-double)
+        // и четырёх varint: движка, модели графа, числа вершин и числа рёбер. Его начало заменяется несуществующей вершиной
+        corrupted = ch_stream.str();
+        size_t first_edge = 4 + 8 + 8 + 2 * sizeof(double);
+        for (int varint = 0; varint < 4; ++varint) {
+            while (static_cast<unsigned char>(corrupted[first_edge++]) & 0x80) {
+            }
+        }
+        size_t first_edge_end = first_edge;
+        while (static_cast<unsigned char>(corrupted[first_edge_end++]) & 0x80) {
+        }
+        const uint64_t missing_vertex = transport_router::GetGraphVertexCount(catalogue, ch_settings.graph_model_) + 1000;
+        corrupted.replace(first_edge, first_edge_end - first_edge,
+                          {static_cast<char>((missing_vertex & 0x7F) | 0x80), static_cast<char>(missing_vertex >> 7)});
+        refused = false;
+        try {
+            std::istringstream input(corrupted);
+            serialization::DeserializeRouterState(input, catalogue, ch_settings);
+        } catch (const serialization::SerializationError&) {
+            refused = true;
+        }
+        ASSERT_EQUAL_HINT(refused, true, "Состояние с ребром из несуществующей вершины не должно загружаться."s);
+    }
+
+    void test::Router_rejects_inconsistent_routes(){
+        // Путь 0 -> 1 -> 2 и обратное ребро 2 -> 1
+        transport_router::GraphBuilder builder(3);
+        builder.AddEdge({0, 1, 1.0});
+        builder.AddEdge({1, 2, 1.0});
+        builder.AddEdge({2, 1, 1.0});
+        const transport_router::Graph graph = builder.Build();
+        const auto edge_id = [&graph](graph::VertexId from, graph::VertexId to) {
+            for (graph::EdgeId id = 0; id < graph.GetEdgeCount(); ++id) {
+                if (graph.GetEdge(id).from == from && graph.GetEdge(id).to == to) {
+                    return static_cast<uint32_t>(id);
+                }
+            }
+            return transport_router::Router::NO_ROUTE_EDGE;
+        };
+        using Routes = transport_router::Router::RoutesInternalData;
+        const Routes valid = transport_router::Router(graph).GetRoutesInternalData();
+        const auto rejected = [&graph](Routes routes) {
+            try {
+                transport_router::Router router(graph, std::move(routes));
+            } catch (const std::invalid_argument&) {
+                return true;
+            }
+            return false;
+        };
+        ASSERT_EQUAL_HINT(rejected(valid), false, "Матрица построенного маршрутизатора должна загружаться."s);
+
+        // Пути 0 -> 1 и 0 -> 2 ссылаются друг на друга: BuildRoute(0, 2) ходил бы по кругу
+        Routes cyclic = valid;
+        cyclic[0 * 3 + 1] = edge_id(2, 1);
+        ASSERT_EQUAL_HINT(rejected(cyclic), true, "Матрица с циклом в пути не должна загружаться."s);
+
+        Routes wrong_end = valid;
+        wrong_end[0 * 3 + 2] = edge_id(0, 1);
+        ASSERT_EQUAL_HINT(rejected(wrong_end), true, "Последнее ребро пути должно заканчиваться в его вершине."s);
+
+        Routes self_path = valid;
+        self_path[1 * 3 + 1] = edge_id(2, 1);
+        ASSERT_EQUAL_HINT(rejected(self_path), true, "Путь из вершины в неё же должен быть пустым."s);
 
+        // Из 2 в 0 пути нет, поэтому путь 2 -> 1, оканчивающийся ребром 0 -> 1, не начинается в 2
+        Routes broken_start = valid;
+        broken_start[2 * 3 + 1] = edge_id(0, 1);
+        ASSERT_EQUAL_HINT(rejected(broken_start), true, "Цепочка последних рёбер должна приходить в начало пути."s);
     }
 
     void test::Checking_the_correctness_of_input_data_processing(){
@@ -236,6 +1243,28 @@ template<typename TestFunc>
         RUN_TEST(Check_for_unique_stops);
         RUN_TEST(Checking_route_in_which_the_distance_is_set_only_in_one_way);
         RUN_TEST(Checking_the_correctness_of_input_data_processing);
+        RUN_TEST(Search_for_nearby_stops);
+        RUN_TEST(Search_by_name_in_frozen_catalogue);
+        RUN_TEST(Checking_segment_length_on_bus);
+        RUN_TEST(Serialization_round_trip);
+        RUN_TEST(Search_for_direct_buses);
+        RUN_TEST(Catalogue_uses_memory_resource);
+        RUN_TEST(Sharded_router_matches_single_router);
+        RUN_TEST(Batch_distance_matches_scalar);
+        RUN_TEST(Approximate_distance_within_error_bound);
+        RUN_TEST(Dijkstra_router_matches_floyd_warshall);
+        RUN_TEST(Route_cache_evicts_least_recently_used);
+        RUN_TEST(Route_batch_reuses_shortest_path_trees);
+        RUN_TEST(Contraction_hierarchy_matches_floyd_warshall);
+        RUN_TEST(A_star_matches_dijkstra_with_fewer_settled_vertices);
+        RUN_TEST(Bidirectional_dijkstra_matches_floyd_warshall);
+        RUN_TEST(Graph_builder_lays_out_edges_by_vertex);
+        RUN_TEST(Route_line_model_matches_stop_pairs);
+        RUN_TEST(Raptor_matches_dijkstra_and_lists_pareto_routes);
+        RUN_TEST(Blocked_floyd_warshall_matches_triple_loop);
+        RUN_TEST(Floyd_warshall_narrows_edge_ids_for_small_graphs);
+        RUN_TEST(Router_state_round_trip);
+        RUN_TEST(Router_rejects_inconsistent_routes);
     }
 
 
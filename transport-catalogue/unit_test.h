@@ -89,6 +89,29 @@ namespace test{
     void Checking_the_correctness_of_input_data_processing();
     void Checking_route_in_which_the_distance_is_set_only_in_one_way();
 
+    void Search_for_nearby_stops();
+    void Search_by_name_in_frozen_catalogue();
+    void Checking_segment_length_on_bus();
+    void Serialization_round_trip();
+    void Search_for_direct_buses();
+    void Catalogue_uses_memory_resource();
+    void Sharded_router_matches_single_router();
+    void Batch_distance_matches_scalar();
+    void Approximate_distance_within_error_bound();
+    void Dijkstra_router_matches_floyd_warshall();
+    void Route_cache_evicts_least_recently_used();
+    void Route_batch_reuses_shortest_path_trees();
+    void Contraction_hierarchy_matches_floyd_warshall();
+    void A_star_matches_dijkstra_with_fewer_settled_vertices();
+    void Bidirectional_dijkstra_matches_floyd_warshall();
+    void Graph_builder_lays_out_edges_by_vertex();
+    void Route_line_model_matches_stop_pairs();
+    void Raptor_matches_dijkstra_and_lists_pareto_routes();
+    void Blocked_floyd_warshall_matches_triple_loop();
+    void Floyd_warshall_narrows_edge_ids_for_small_graphs();
+    void Router_state_round_trip();
+    void Router_rejects_inconsistent_routes();
+
     void TestTransportCatalogue();
 
 }